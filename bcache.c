@@ -19,26 +19,71 @@
 #include "config.h"
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include "bcache.h"
 #include "account.h"
 #include "globals.h"
+#include "hash.h"
 #include "lib.h"
+#include "md5.h"
+#include "mx.h"
 #include "protos.h"
 #include "url.h"
 
+/* Each cache directory keeps an index of its entries in this file, so that
+ * exists/list/eviction don't need a stat() per message.  Its first line
+ * records the directory's mtime and the pack's size as they were when it
+ * was written; if either has moved on since, another process changed the
+ * cache and the index is rebuilt or topped up.  Bodies themselves
+ * are content-addressed below $message_cachedir/BCACHE_OBJECTS and hard
+ * linked into every mailbox that holds a copy.
+ *
+ * With $message_cache_backend set to "pack", bodies are instead appended to
+ * a single BCACHE_PACK file per directory.  Every record there starts with a
+ * "+<id> <size>\n" header whose '+' becomes '-' when the record is dropped,
+ * so the pack can be rescanned without the index and dead space reclaimed
+ * by rewriting it. */
+#define BCACHE_INDEX   ".index"
+#define BCACHE_PACK    ".pack"
+#define BCACHE_OBJECTS ".objects"
+#define BCACHE_MAGIC   "bcache-index 3"
+
 static int mutt_bcache_move(struct BodyCache *bcache, const char *id, const char *newid);
 
+struct BcacheEntry
+{
+  char *id;
+  off_t size;
+  time_t used;     /* last access, for LRU eviction */
+  off_t offset;    /* record header in the pack, -1 for a plain file */
+  char digest[33]; /* hex md5 of a shared body, "" if not shared */
+  bool seen;       /* found by the current bcache_scan() */
+};
+
 struct BodyCache
 {
   char path[_POSIX_PATH_MAX];
   size_t pathlen;
+  struct Hash *index; /* id -> struct BcacheEntry */
+  off_t total;        /* bytes held by the entries in index */
+  bool dirty;         /* index needs writing back */
+  bool packed;        /* store new bodies in the pack file */
+  FILE *pack;         /* opened on first use */
 };
 
+/* lifetime counters, reported at close */
+static unsigned long BcacheHits = 0;
+static unsigned long BcacheMisses = 0;
+static unsigned long BcacheEvictions = 0;
+static unsigned long BcacheShared = 0;
+
 static int bcache_path(struct Account *account, const char *mailbox, char *dst, size_t dstlen)
 {
   char host[STRING];
@@ -82,6 +127,789 @@ static int bcache_path(struct Account *account, const char *mailbox, char *dst,
   return 0;
 }
 
+static void bcache_entry_free(void *data)
+{
+  struct BcacheEntry *entry = data;
+
+  FREE(&entry->id);
+  FREE(&entry);
+}
+
+static void bcache_entry_path(struct BodyCache *bcache, const char *id,
+                              char *dst, size_t dstlen)
+{
+  dst[0] = '\0';
+  safe_strncat(dst, dstlen, bcache->path, bcache->pathlen);
+  safe_strncat(dst, dstlen, id, mutt_strlen(id));
+}
+
+/* shared bodies live in two levels below the objects directory so that no
+ * single directory ends up holding every cached message */
+static void bcache_object_path(const char *digest, char *dst, size_t dstlen)
+{
+  snprintf(dst, dstlen, "%s/%s/%.2s/%s", MessageCachedir, BCACHE_OBJECTS,
+           digest, digest + 2);
+}
+
+static struct BcacheEntry *bcache_add(struct BodyCache *bcache, const char *id,
+                                      off_t size, time_t used,
+                                      const char *digest, off_t offset)
+{
+  struct BcacheEntry *entry = safe_calloc(1, sizeof(struct BcacheEntry));
+
+  entry->id = safe_strdup(id);
+  entry->size = size;
+  entry->used = used;
+  entry->offset = offset;
+  if (digest)
+    strfcpy(entry->digest, digest, sizeof(entry->digest));
+
+  if (bcache->index->curnelem > 2 * bcache->index->nelem)
+    bcache->index = hash_resize(bcache->index, 4 * bcache->index->nelem, 0);
+  hash_insert(bcache->index, entry->id, entry);
+  bcache->total += size;
+  bcache->dirty = true;
+
+  return entry;
+}
+
+static void bcache_remove(struct BodyCache *bcache, const char *id)
+{
+  struct BcacheEntry *entry = hash_find(bcache->index, id);
+
+  if (!entry)
+    return;
+
+  bcache->total -= entry->size;
+  bcache->dirty = true;
+  /* the key is owned by the entry, so look it up by the caller's copy */
+  hash_delete(bcache->index, id, entry, bcache_entry_free);
+}
+
+/* drop a shared body once no mailbox links to it any more */
+static void bcache_release(const char *digest)
+{
+  char path[_POSIX_PATH_MAX];
+  struct stat st;
+
+  if (!digest || !*digest)
+    return;
+
+  bcache_object_path(digest, path, sizeof(path));
+  if (stat(path, &st) == 0 && st.st_nlink <= 1)
+  {
+    mutt_debug(3, "bcache: release: '%s'\n", path);
+    unlink(path);
+  }
+}
+
+static int bcache_digest(FILE *fp, char *digest)
+{
+  unsigned char md5[16];
+
+  rewind(fp);
+  if (md5_stream(fp, md5) != 0)
+    return -1;
+  for (int i = 0; i < 16; i++)
+    sprintf(digest + 2 * i, "%02x", md5[i]);
+
+  return 0;
+}
+
+static bool bcache_same(FILE *fp, const char *path)
+{
+  char buf1[BUFSIZ], buf2[BUFSIZ];
+  FILE *ofp = NULL;
+  size_t n1, n2;
+  bool same = false;
+
+  if (!(ofp = fopen(path, "r")))
+    return false;
+
+  rewind(fp);
+  do
+  {
+    n1 = fread(buf1, 1, sizeof(buf1), fp);
+    n2 = fread(buf2, 1, sizeof(buf2), ofp);
+    if (n1 != n2 || memcmp(buf1, buf2, n1) != 0)
+      goto out;
+  } while (n1 == sizeof(buf1));
+  same = feof(fp) && feof(ofp);
+
+out:
+  safe_fclose(&ofp);
+  return same;
+}
+
+/* Replace a freshly committed body by a link to an identical shared copy, or
+ * publish it as the shared copy if there is none yet.  The digest only picks
+ * the candidate; contents are compared before anything is linked. */
+static void bcache_share(struct BcacheEntry *entry, const char *path)
+{
+  char digest[33];
+  char objpath[_POSIX_PATH_MAX];
+  char lnkpath[_POSIX_PATH_MAX];
+  struct stat st;
+  FILE *fp = NULL;
+
+  if (!(fp = fopen(path, "r")))
+    return;
+  /* only name the body after its digest if it's all there: a file that
+   * is still being written to would be filed under the wrong one */
+  if (fstat(fileno(fp), &st) < 0 || st.st_size != entry->size ||
+      bcache_digest(fp, digest) < 0 || ftello(fp) != entry->size)
+    goto out;
+
+  bcache_object_path(digest, objpath, sizeof(objpath));
+  if (stat(objpath, &st) == 0)
+  {
+    if (st.st_size != entry->size || !bcache_same(fp, objpath))
+      goto out;
+
+    snprintf(lnkpath, sizeof(lnkpath), "%s.lnk", path);
+    unlink(lnkpath);
+    if (link(objpath, lnkpath) < 0 || rename(lnkpath, path) < 0)
+    {
+      unlink(lnkpath);
+      goto out;
+    }
+    BcacheShared++;
+  }
+  else
+  {
+    char *p = strrchr(objpath, '/');
+
+    *p = '\0';
+    if (mutt_mkdir(objpath, S_IRWXU | S_IRWXG | S_IRWXO) < 0)
+      goto out;
+    *p = '/';
+    if (link(path, objpath) < 0)
+      goto out;
+  }
+
+  mutt_debug(3, "bcache: share: '%s' -> '%s'\n", path, objpath);
+  strfcpy(entry->digest, digest, sizeof(entry->digest));
+
+out:
+  safe_fclose(&fp);
+}
+
+static int bcache_pack_header(const char *id, off_t size, char *dst, size_t dstlen)
+{
+  return snprintf(dst, dstlen, "+%s %lld\n", id, (long long) size);
+}
+
+static FILE *bcache_pack_open(struct BodyCache *bcache)
+{
+  char path[_POSIX_PATH_MAX];
+  int fd;
+
+  if (bcache->pack)
+    return bcache->pack;
+
+  bcache_entry_path(bcache, BCACHE_PACK, path, sizeof(path));
+  if ((fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR)) < 0)
+    return NULL;
+  if (!(bcache->pack = fdopen(fd, "r+")))
+    close(fd);
+
+  return bcache->pack;
+}
+
+/* Check that the pack still holds the entry's record, which it may not if
+ * another process rewrote the pack, and leave the pack positioned at the
+ * start of the body. */
+static bool bcache_pack_check(struct BodyCache *bcache, struct BcacheEntry *entry)
+{
+  char hdr[LONG_STRING];
+  char buf[LONG_STRING];
+  int len;
+
+  len = bcache_pack_header(entry->id, entry->size, hdr, sizeof(hdr));
+  if (len < 0 || len >= sizeof(hdr) || !bcache_pack_open(bcache))
+    return false;
+
+  if (fseeko(bcache->pack, entry->offset, SEEK_SET) != 0)
+    return false;
+
+  return fread(buf, 1, len, bcache->pack) == len && memcmp(buf, hdr, len) == 0;
+}
+
+static int bcache_pack_copy(FILE *fin, FILE *fout, off_t size)
+{
+  char buf[BUFSIZ];
+  size_t n;
+
+  while (size > 0 && (n = fread(buf, 1, MIN(sizeof(buf), size), fin)) > 0)
+  {
+    if (fwrite(buf, 1, n, fout) != n)
+      return -1;
+    size -= n;
+  }
+
+  return size == 0 ? 0 : -1;
+}
+
+static FILE *bcache_pack_get(struct BodyCache *bcache, struct BcacheEntry *entry)
+{
+  FILE *fp = NULL;
+
+  if (!bcache_pack_check(bcache, entry))
+    return NULL;
+
+#ifdef USE_FMEMOPEN
+  /* one spare byte for the terminating NUL fmemopen() writes on flush */
+  fp = fmemopen(NULL, entry->size + 1, "w+");
+#else
+  char tempfile[_POSIX_PATH_MAX];
+
+  mutt_mktemp(tempfile, sizeof(tempfile));
+  if ((fp = safe_fopen(tempfile, "w+")))
+    unlink(tempfile);
+#endif
+  if (!fp)
+    return NULL;
+
+  if (bcache_pack_copy(bcache->pack, fp, entry->size) < 0)
+  {
+    safe_fclose(&fp);
+    return NULL;
+  }
+  rewind(fp);
+
+  return fp;
+}
+
+/* Append the file at path to the pack, returning the record's offset */
+static off_t bcache_pack_append(struct BodyCache *bcache, const char *id,
+                                const char *path, off_t *size)
+{
+  char hdr[LONG_STRING];
+  char packpath[_POSIX_PATH_MAX];
+  struct stat st;
+  FILE *fp = NULL;
+  off_t offset = -1;
+  int len;
+
+  if (!(fp = fopen(path, "r")) || fstat(fileno(fp), &st) < 0 || st.st_size == 0)
+    goto out;
+
+  len = bcache_pack_header(id, st.st_size, hdr, sizeof(hdr));
+  if (len < 0 || len >= sizeof(hdr) || strchr(id, '\n') || !bcache_pack_open(bcache))
+    goto out;
+
+  bcache_entry_path(bcache, BCACHE_PACK, packpath, sizeof(packpath));
+  if (mx_lock_file(packpath, fileno(bcache->pack), 1, 0, 1) < 0)
+    goto out;
+
+  if (fseeko(bcache->pack, 0, SEEK_END) == 0 && (offset = ftello(bcache->pack)) >= 0)
+  {
+    /* a file that grows while it's copied is still being written to */
+    if (fwrite(hdr, 1, len, bcache->pack) != len ||
+        bcache_pack_copy(fp, bcache->pack, st.st_size) < 0 || (fgetc(fp) != EOF) ||
+        fflush(bcache->pack) != 0)
+    {
+      /* don't leave a torn record behind */
+      clearerr(bcache->pack);
+      if (ftruncate(fileno(bcache->pack), offset) < 0)
+        mutt_debug(1, "bcache: can't truncate '%s'\n", packpath);
+      offset = -1;
+    }
+  }
+
+  mx_unlock_file(packpath, fileno(bcache->pack), 0);
+  *size = st.st_size;
+
+out:
+  safe_fclose(&fp);
+  return offset;
+}
+
+static void bcache_pack_kill(struct BodyCache *bcache, struct BcacheEntry *entry)
+{
+  if (!bcache_pack_check(bcache, entry) || fseeko(bcache->pack, entry->offset, SEEK_SET) != 0)
+    return;
+
+  fputc('-', bcache->pack);
+  fflush(bcache->pack);
+}
+
+static int bcache_offset_cmp(const void *a, const void *b)
+{
+  const struct BcacheEntry *ea = *(const struct BcacheEntry **) a;
+  const struct BcacheEntry *eb = *(const struct BcacheEntry **) b;
+
+  return (ea->offset > eb->offset) - (ea->offset < eb->offset);
+}
+
+/* Rewrite the pack without its dead records once they take up at least
+ * half of it.  Records that fail their check are dropped from the index. */
+static void bcache_pack_compact(struct BodyCache *bcache)
+{
+  struct BcacheEntry **entries = NULL;
+  struct HashWalkState state;
+  struct HashElem *elem = NULL;
+  char path[_POSIX_PATH_MAX];
+  char tmppath[_POSIX_PATH_MAX];
+  char hdr[LONG_STRING];
+  off_t *offsets = NULL;
+  off_t live = 0;
+  struct stat st;
+  FILE *fp = NULL;
+  int n = 0;
+
+  if (!bcache->pack || fstat(fileno(bcache->pack), &st) < 0)
+    return;
+
+  entries = safe_malloc((bcache->index->curnelem + 1) * sizeof(struct BcacheEntry *));
+  memset(&state, 0, sizeof(state));
+  while ((elem = hash_walk(bcache->index, &state)))
+  {
+    struct BcacheEntry *entry = elem->data;
+
+    if (entry->offset < 0)
+      continue;
+    entries[n++] = entry;
+    live += bcache_pack_header(entry->id, entry->size, hdr, sizeof(hdr)) + entry->size;
+  }
+
+  if (live * 2 > st.st_size)
+    goto out;
+
+  bcache_entry_path(bcache, BCACHE_PACK, path, sizeof(path));
+  mutt_debug(2, "bcache: compact: '%s': %lld of %lld bytes live\n", path,
+             (long long) live, (long long) st.st_size);
+
+  if (n == 0)
+  {
+    unlink(path);
+    safe_fclose(&bcache->pack);
+    goto out;
+  }
+
+  if (mx_lock_file(path, fileno(bcache->pack), 1, 0, 1) < 0)
+    goto out;
+
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+  if (!(fp = safe_fopen(tmppath, "w")))
+  {
+    mx_unlock_file(path, fileno(bcache->pack), 0);
+    goto out;
+  }
+
+  qsort(entries, n, sizeof(struct BcacheEntry *), bcache_offset_cmp);
+  offsets = safe_malloc(n * sizeof(off_t));
+  for (int i = 0; i < n; i++)
+  {
+    offsets[i] = -1;
+    if (!bcache_pack_check(bcache, entries[i]))
+      continue;
+
+    bcache_pack_header(entries[i]->id, entries[i]->size, hdr, sizeof(hdr));
+    offsets[i] = ftello(fp);
+    fputs(hdr, fp);
+    if (bcache_pack_copy(bcache->pack, fp, entries[i]->size) < 0)
+      break;
+  }
+
+  if (ferror(fp) || safe_fclose(&fp) != 0 || rename(tmppath, path) < 0)
+  {
+    safe_fclose(&fp);
+    unlink(tmppath);
+    mx_unlock_file(path, fileno(bcache->pack), 0);
+    goto out;
+  }
+
+  mx_unlock_file(path, fileno(bcache->pack), 0);
+  safe_fclose(&bcache->pack);
+
+  for (int i = 0; i < n; i++)
+  {
+    if (offsets[i] < 0)
+    {
+      char *id = safe_strdup(entries[i]->id);
+
+      bcache_remove(bcache, id);
+      FREE(&id);
+    }
+    else
+      entries[i]->offset = offsets[i];
+  }
+  bcache->dirty = true;
+
+out:
+  FREE(&offsets);
+  FREE(&entries);
+}
+
+/* Remove an entry's body, wherever it is stored, and forget about it */
+static int bcache_drop(struct BodyCache *bcache, const char *id)
+{
+  char path[_POSIX_PATH_MAX];
+  char digest[33];
+  struct BcacheEntry *entry = hash_find(bcache->index, id);
+  int rc = 0;
+
+  digest[0] = '\0';
+  if (entry)
+    strfcpy(digest, entry->digest, sizeof(digest));
+
+  if (entry && entry->offset >= 0)
+    bcache_pack_kill(bcache, entry);
+  else
+  {
+    bcache_entry_path(bcache, id, path, sizeof(path));
+    rc = unlink(path);
+  }
+
+  bcache_remove(bcache, id);
+  bcache_release(digest);
+
+  return rc;
+}
+
+static off_t bcache_pack_size(struct BodyCache *bcache)
+{
+  char path[_POSIX_PATH_MAX];
+  struct stat st;
+
+  bcache_entry_path(bcache, BCACHE_PACK, path, sizeof(path));
+  return (stat(path, &st) == 0) ? st.st_size : 0;
+}
+
+/* Read the index at path, unless the directory was changed (dirmtime) since
+ * it was written.  Returns 0 on success, 1 if the index is stale and -1 if
+ * it is missing or corrupt.  *packsize is set to the size of the pack the
+ * index covers. */
+static int bcache_read_index(struct BodyCache *bcache, const char *path,
+                             time_t dirmtime, off_t *packsize)
+{
+  char buf[LONG_STRING];
+  char digest[33];
+  long long size, used, offset, mtime;
+  int n;
+  FILE *fp = NULL;
+  int rc = -1;
+
+  if (!(fp = fopen(path, "r")))
+    return -1;
+  /* the writer rewrites the index in place under this lock */
+  if (mx_lock_file(path, fileno(fp), 0, 0, 1) < 0)
+  {
+    safe_fclose(&fp);
+    return -1;
+  }
+
+  if (!fgets(buf, sizeof(buf), fp) ||
+      (mutt_strncmp(buf, BCACHE_MAGIC " ", sizeof(BCACHE_MAGIC)) != 0) ||
+      (sscanf(buf + sizeof(BCACHE_MAGIC), "%lld %lld", &mtime, &size) != 2))
+    goto out;
+
+  if ((mtime == 0) || (mtime != dirmtime))
+  {
+    rc = 1;
+    goto out;
+  }
+  *packsize = size;
+
+  while (fgets(buf, sizeof(buf), fp))
+  {
+    char *id = NULL;
+    size_t len = mutt_strlen(buf);
+
+    if (!len || buf[len - 1] != '\n')
+      goto out;
+    buf[len - 1] = '\0';
+
+    if (sscanf(buf, "%lld %lld %32s %lld %n", &size, &used, digest, &offset, &n) != 4)
+      goto out;
+    id = buf + n;
+    if (!*id || hash_find(bcache->index, id))
+      goto out;
+
+    bcache_add(bcache, id, size, used, (digest[0] == '-') ? NULL : digest, offset);
+  }
+  rc = 0;
+
+out:
+  mx_unlock_file(path, fileno(fp), 0);
+  safe_fclose(&fp);
+  return rc;
+}
+
+/* Add the live records of the pack to the index.  Anything after a record
+ * that doesn't parse, such as a torn append, is ignored. */
+static void bcache_scan_pack(struct BodyCache *bcache)
+{
+  char buf[LONG_STRING];
+  char path[_POSIX_PATH_MAX];
+  struct stat st;
+  off_t offset = 0;
+  long long size;
+  char *p = NULL;
+
+  bcache_entry_path(bcache, BCACHE_PACK, path, sizeof(path));
+  if (stat(path, &st) < 0 || !bcache_pack_open(bcache))
+    return;
+
+  rewind(bcache->pack);
+  while (fgets(buf, sizeof(buf), bcache->pack))
+  {
+    size_t len = mutt_strlen(buf);
+
+    if (!len || buf[len - 1] != '\n' || (buf[0] != '+' && buf[0] != '-') ||
+        !(p = strrchr(buf, ' ')) || sscanf(p + 1, "%lld", &size) != 1 || size <= 0)
+      break;
+    *p = '\0';
+
+    if (buf[0] == '+' && !hash_find(bcache->index, buf + 1))
+      bcache_add(bcache, buf + 1, size, st.st_mtime, NULL, offset);
+
+    offset += len + size;
+    if (fseeko(bcache->pack, offset, SEEK_SET) != 0)
+      break;
+  }
+}
+
+/* Bring the index in line with the directory: add the bodies it doesn't
+ * know about and forget the plain files that have gone.  Only new names
+ * are stat()ed.  Shared bodies are recognised by their link count and
+ * matched back to their object. */
+static void bcache_scan(struct BodyCache *bcache)
+{
+  char path[_POSIX_PATH_MAX];
+  char objpath[_POSIX_PATH_MAX];
+  char digest[33];
+  struct BcacheEntry **gone = NULL;
+  struct BcacheEntry *entry = NULL;
+  struct HashWalkState state;
+  struct HashElem *elem = NULL;
+  struct dirent *de = NULL;
+  struct stat st, ost;
+  DIR *d = NULL;
+  int n = 0;
+
+  if (!(d = opendir(bcache->path)))
+    return;
+
+  mutt_debug(2, "bcache: scan: dir: '%s'\n", bcache->path);
+
+  while ((de = readdir(d)))
+  {
+    size_t len = mutt_strlen(de->d_name);
+
+    if (de->d_name[0] == '.' ||
+        (len > 4 && (mutt_strcmp(de->d_name + len - 4, ".tmp") == 0)) ||
+        (len > 4 && (mutt_strcmp(de->d_name + len - 4, ".lnk") == 0)))
+      continue;
+
+    if ((entry = hash_find(bcache->index, de->d_name)))
+    {
+      entry->seen = true;
+      continue;
+    }
+
+    bcache_entry_path(bcache, de->d_name, path, sizeof(path));
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+      continue;
+
+    digest[0] = '\0';
+    if (st.st_nlink > 1)
+    {
+      FILE *fp = fopen(path, "r");
+
+      if (fp && bcache_digest(fp, digest) == 0)
+      {
+        bcache_object_path(digest, objpath, sizeof(objpath));
+        if (stat(objpath, &ost) < 0 || ost.st_ino != st.st_ino || ost.st_dev != st.st_dev)
+          digest[0] = '\0';
+      }
+      else
+        digest[0] = '\0';
+      safe_fclose(&fp);
+    }
+
+    bcache_add(bcache, de->d_name, st.st_size, st.st_mtime, digest, -1)->seen = true;
+  }
+  closedir(d);
+
+  gone = safe_malloc((bcache->index->curnelem + 1) * sizeof(struct BcacheEntry *));
+  memset(&state, 0, sizeof(state));
+  while ((elem = hash_walk(bcache->index, &state)))
+  {
+    entry = elem->data;
+    if (entry->offset < 0 && !entry->seen)
+      gone[n++] = entry;
+    entry->seen = false;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    char *id = safe_strdup(gone[i]->id);
+
+    mutt_debug(3, "bcache: scan: '%s%s' has gone\n", bcache->path, id);
+    bcache_remove(bcache, id);
+    FREE(&id);
+  }
+  FREE(&gone);
+
+  bcache_scan_pack(bcache);
+  bcache->dirty = true;
+}
+
+static void bcache_load(struct BodyCache *bcache)
+{
+  char path[_POSIX_PATH_MAX];
+  struct stat st;
+  off_t packsize = 0;
+  int rc;
+
+  bcache->index = hash_create(1031, 0);
+  if (stat(bcache->path, &st) < 0)
+    return;
+
+  bcache_entry_path(bcache, BCACHE_INDEX, path, sizeof(path));
+  rc = bcache_read_index(bcache, path, st.st_mtime, &packsize);
+  if (rc == 0)
+  {
+    bcache->dirty = false;
+    /* appends by others only grow the pack, they don't touch the directory */
+    if (packsize != bcache_pack_size(bcache))
+    {
+      bcache_scan_pack(bcache);
+      bcache->dirty = true;
+    }
+    return;
+  }
+
+  if (rc < 0 && access(path, F_OK) == 0)
+    mutt_debug(1, "bcache: corrupt index '%s'\n", path);
+  hash_destroy(&bcache->index, bcache_entry_free);
+  bcache->index = hash_create(1031, 0);
+  bcache->total = 0;
+
+  bcache_scan(bcache);
+}
+
+/* Rewrite the index in place, so that writing it doesn't itself change the
+ * directory's mtime.  Before it's written, the index is brought up to date
+ * with whatever other processes did to the cache since it was loaded. */
+static void bcache_write_index(struct BodyCache *bcache)
+{
+  char path[_POSIX_PATH_MAX];
+  struct HashWalkState state;
+  struct HashElem *elem = NULL;
+  struct stat st;
+  off_t packsize;
+  FILE *fp = NULL;
+  int fd;
+
+  bcache_entry_path(bcache, BCACHE_INDEX, path, sizeof(path));
+
+  /* leave nothing behind in a directory that has been emptied */
+  if (bcache->index->curnelem == 0)
+  {
+    unlink(path);
+    bcache_entry_path(bcache, BCACHE_PACK, path, sizeof(path));
+    unlink(path);
+    return;
+  }
+
+  if (!bcache->dirty)
+    return;
+
+  if ((fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR)) < 0)
+    return;
+  if (!(fp = fdopen(fd, "r+")))
+  {
+    close(fd);
+    return;
+  }
+  if (mx_lock_file(path, fileno(fp), 1, 0, 1) < 0)
+  {
+    safe_fclose(&fp);
+    return;
+  }
+
+  /* Any change after this stat() moves the mtime on, unless it happens
+   * within the same second; then record 0 so the next load rescans. */
+  if (stat(bcache->path, &st) < 0 || st.st_mtime >= time(NULL) - 1)
+    st.st_mtime = 0;
+  packsize = bcache_pack_size(bcache);
+  bcache_scan(bcache);
+
+  if (ftruncate(fileno(fp), 0) == 0)
+  {
+    rewind(fp);
+    fprintf(fp, "%s %lld %lld\n", BCACHE_MAGIC, (long long) st.st_mtime,
+            (long long) packsize);
+    memset(&state, 0, sizeof(state));
+    while ((elem = hash_walk(bcache->index, &state)))
+    {
+      struct BcacheEntry *entry = elem->data;
+
+      fprintf(fp, "%lld %lld %s %lld %s\n", (long long) entry->size,
+              (long long) entry->used, entry->digest[0] ? entry->digest : "-",
+              (long long) entry->offset, entry->id);
+    }
+  }
+
+  /* a short index would be trusted, so don't leave one behind */
+  if (fflush(fp) != 0 || ferror(fp))
+  {
+    mutt_debug(1, "bcache: can't write '%s'\n", path);
+    unlink(path);
+  }
+  else
+    bcache->dirty = false;
+
+  mx_unlock_file(path, fileno(fp), 0);
+  safe_fclose(&fp);
+}
+
+static int bcache_lru_cmp(const void *a, const void *b)
+{
+  const struct BcacheEntry *ea = *(const struct BcacheEntry **) a;
+  const struct BcacheEntry *eb = *(const struct BcacheEntry **) b;
+
+  return (ea->used > eb->used) - (ea->used < eb->used);
+}
+
+/* Evict the least recently used entries until the cache fits
+ * $message_cache_size again.  The entry named keep is never evicted. */
+static void bcache_evict(struct BodyCache *bcache, const char *keep)
+{
+  struct BcacheEntry **entries = NULL;
+  struct HashWalkState state;
+  struct HashElem *elem = NULL;
+  char *id = NULL;
+  off_t budget = (off_t) MessageCacheSize * 1024 * 1024;
+  int n = 0;
+
+  if (MessageCacheSize <= 0 || bcache->total <= budget)
+    return;
+
+  entries = safe_malloc(bcache->index->curnelem * sizeof(struct BcacheEntry *));
+  memset(&state, 0, sizeof(state));
+  while ((elem = hash_walk(bcache->index, &state)))
+    entries[n++] = elem->data;
+  qsort(entries, n, sizeof(struct BcacheEntry *), bcache_lru_cmp);
+
+  for (int i = 0; i < n && bcache->total > budget; i++)
+  {
+    if (mutt_strcmp(entries[i]->id, keep) == 0)
+      continue;
+
+    id = safe_strdup(entries[i]->id);
+    mutt_debug(3, "bcache: evict: '%s%s'\n", bcache->path, id);
+
+    bcache_drop(bcache, id);
+    BcacheEvictions++;
+    FREE(&id);
+  }
+
+  FREE(&entries);
+}
+
 struct BodyCache *mutt_bcache_open(struct Account *account, const char *mailbox)
 {
   struct BodyCache *bcache = NULL;
@@ -93,6 +921,8 @@ struct BodyCache *mutt_bcache_open(struct Account *account, const char *mailbox)
   if (bcache_path(account, mailbox, bcache->path, sizeof(bcache->path)) < 0)
     goto bail;
   bcache->pathlen = mutt_strlen(bcache->path);
+  bcache->packed = (mutt_strcmp(MessageCacheBackend, "pack") == 0);
+  bcache_load(bcache);
 
   return bcache;
 
@@ -106,22 +936,51 @@ void mutt_bcache_close(struct BodyCache **bcache)
 {
   if (!bcache || !*bcache)
     return;
+
+  bcache_pack_compact(*bcache);
+  bcache_write_index(*bcache);
+  mutt_debug(2, "bcache: close: '%s': %d entries, %lld bytes; "
+                "%lu hits, %lu misses, %lu evictions, %lu shared\n",
+             (*bcache)->path, (*bcache)->index->curnelem,
+             (long long) (*bcache)->total, BcacheHits, BcacheMisses,
+             BcacheEvictions, BcacheShared);
+
+  hash_destroy(&(*bcache)->index, bcache_entry_free);
+  safe_fclose(&(*bcache)->pack);
   FREE(bcache);
 }
 
 FILE *mutt_bcache_get(struct BodyCache *bcache, const char *id)
 {
   char path[_POSIX_PATH_MAX];
+  struct BcacheEntry *entry = NULL;
   FILE *fp = NULL;
 
   if (!id || !*id || !bcache)
     return NULL;
 
-  path[0] = '\0';
-  safe_strncat(path, sizeof(path), bcache->path, bcache->pathlen);
-  safe_strncat(path, sizeof(path), id, mutt_strlen(id));
+  bcache_entry_path(bcache, id, path, sizeof(path));
 
-  fp = safe_fopen(path, "r");
+  if ((entry = hash_find(bcache->index, id)))
+  {
+    if (entry->offset >= 0)
+      fp = bcache_pack_get(bcache, entry);
+    else
+      fp = safe_fopen(path, "r");
+  }
+
+  if (fp)
+  {
+    BcacheHits++;
+    entry->used = time(NULL);
+    bcache->dirty = true;
+  }
+  else
+  {
+    BcacheMisses++;
+    if (entry)
+      bcache_remove(bcache, id);
+  }
 
   mutt_debug(3, "bcache: get: '%s': %s\n", path, fp == NULL ? "no" : "yes");
 
@@ -156,16 +1015,59 @@ FILE *mutt_bcache_put(struct BodyCache *bcache, const char *id, int tmp)
   snprintf(path, sizeof(path), "%s%s%s", bcache->path, id, tmp ? ".tmp" : "");
   mutt_debug(3, "bcache: put: '%s'\n", path);
 
+  /* writing in place must not go through a link to a shared body; the
+   * size is picked up by mutt_bcache_exists() once the caller is done */
+  if (!tmp)
+  {
+    mutt_bcache_del(bcache, id);
+    bcache_add(bcache, id, 0, time(NULL), NULL, -1);
+  }
+
   return safe_fopen(path, "w+");
 }
 
 int mutt_bcache_commit(struct BodyCache *bcache, const char *id)
 {
   char tmpid[_POSIX_PATH_MAX];
+  char path[_POSIX_PATH_MAX];
+  struct BcacheEntry *entry = NULL;
+  struct stat st;
+  off_t offset, size;
+
+  if (!bcache || !id || !*id)
+    return -1;
 
   snprintf(tmpid, sizeof(tmpid), "%s.tmp", id);
 
-  return mutt_bcache_move(bcache, tmpid, id);
+  /* the new copy supersedes whatever was cached before */
+  if (hash_find(bcache->index, id))
+    bcache_drop(bcache, id);
+
+  if (bcache->packed)
+  {
+    bcache_entry_path(bcache, tmpid, path, sizeof(path));
+    if ((offset = bcache_pack_append(bcache, id, path, &size)) >= 0)
+    {
+      unlink(path);
+      bcache_add(bcache, id, size, time(NULL), NULL, offset);
+      bcache_evict(bcache, id);
+      return 0;
+    }
+    mutt_debug(1, "bcache: can't append '%s' to the pack\n", path);
+  }
+
+  if (mutt_bcache_move(bcache, tmpid, id) < 0)
+    return -1;
+
+  bcache_entry_path(bcache, id, path, sizeof(path));
+  if (stat(path, &st) < 0)
+    return -1;
+
+  entry = bcache_add(bcache, id, st.st_size, time(NULL), NULL, -1);
+  bcache_share(entry, path);
+  bcache_evict(bcache, id);
+
+  return 0;
 }
 
 static int mutt_bcache_move(struct BodyCache *bcache, const char *id, const char *newid)
@@ -186,37 +1088,37 @@ static int mutt_bcache_move(struct BodyCache *bcache, const char *id, const char
 
 int mutt_bcache_del(struct BodyCache *bcache, const char *id)
 {
-  char path[_POSIX_PATH_MAX];
-
   if (!id || !*id || !bcache)
     return -1;
 
-  path[0] = '\0';
-  safe_strncat(path, sizeof(path), bcache->path, bcache->pathlen);
-  safe_strncat(path, sizeof(path), id, mutt_strlen(id));
-
-  mutt_debug(3, "bcache: del: '%s'\n", path);
+  mutt_debug(3, "bcache: del: '%s%s'\n", bcache->path, id);
 
-  return unlink(path);
+  return bcache_drop(bcache, id);
 }
 
 int mutt_bcache_exists(struct BodyCache *bcache, const char *id)
 {
   char path[_POSIX_PATH_MAX];
+  struct BcacheEntry *entry = NULL;
   struct stat st;
-  int rc = 0;
+  int rc = -1;
 
   if (!id || !*id || !bcache)
     return -1;
 
-  path[0] = '\0';
-  safe_strncat(path, sizeof(path), bcache->path, bcache->pathlen);
-  safe_strncat(path, sizeof(path), id, mutt_strlen(id));
+  bcache_entry_path(bcache, id, path, sizeof(path));
 
-  if (stat(path, &st) < 0)
-    rc = -1;
-  else
-    rc = S_ISREG(st.st_mode) && st.st_size != 0 ? 0 : -1;
+  if ((entry = hash_find(bcache->index, id)))
+  {
+    /* written in place by mutt_bcache_put(), size not known yet */
+    if (entry->size == 0 && stat(path, &st) == 0 && S_ISREG(st.st_mode))
+    {
+      entry->size = st.st_size;
+      bcache->total += st.st_size;
+      bcache->dirty = true;
+    }
+    rc = entry->size != 0 ? 0 : -1;
+  }
 
   mutt_debug(3, "bcache: exists: '%s': %s\n", path, rc == 0 ? "yes" : "no");
 
@@ -227,37 +1129,40 @@ int mutt_bcache_list(struct BodyCache *bcache,
                      int (*want_id)(const char *id, struct BodyCache *bcache, void *data),
                      void *data)
 {
-  DIR *d = NULL;
-  struct dirent *de = NULL;
+  struct HashWalkState state;
+  struct HashElem *elem = NULL;
+  char **ids = NULL;
+  int n = 0;
   int rc = -1;
 
-  if (!bcache || !(d = opendir(bcache->path)))
+  if (!bcache)
     goto out;
 
   rc = 0;
 
   mutt_debug(3, "bcache: list: dir: '%s'\n", bcache->path);
 
-  while ((de = readdir(d)))
-  {
-    if ((mutt_strncmp(de->d_name, ".", 1) == 0) ||
-        (mutt_strncmp(de->d_name, "..", 2) == 0))
-      continue;
+  /* want_id() may delete entries, so don't walk the index while calling it */
+  ids = safe_malloc((bcache->index->curnelem + 1) * sizeof(char *));
+  memset(&state, 0, sizeof(state));
+  while ((elem = hash_walk(bcache->index, &state)))
+    ids[n++] = safe_strdup(((struct BcacheEntry *) elem->data)->id);
 
-    mutt_debug(3, "bcache: list: dir: '%s', id :'%s'\n", bcache->path, de->d_name);
+  for (int i = 0; i < n; i++)
+  {
+    mutt_debug(3, "bcache: list: dir: '%s', id :'%s'\n", bcache->path, ids[i]);
 
-    if (want_id && want_id(de->d_name, bcache, data) != 0)
-      goto out;
+    if (want_id && want_id(ids[i], bcache, data) != 0)
+      break;
 
     rc++;
   }
 
+  for (int i = 0; i < n; i++)
+    FREE(&ids[i]);
+  FREE(&ids);
+
 out:
-  if (d)
-  {
-    if (closedir(d) < 0)
-      rc = -1;
-  }
   mutt_debug(3, "bcache: list: did %d entries\n", rc);
   return rc;
 }
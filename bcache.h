@@ -47,7 +47,8 @@ void mutt_bcache_close(struct BodyCache **bcache);
 
 FILE *mutt_bcache_get(struct BodyCache *bcache, const char *id);
 /* tmp: the returned FILE* is in a temporary location.
- *      if set, use mutt_bcache_commit to put it into place */
+ *      if set, use mutt_bcache_commit to put it into place, after the
+ *      FILE* has been flushed or closed: the commit reads the file by name */
 FILE *mutt_bcache_put(struct BodyCache *bcache, const char *id, int tmp);
 int mutt_bcache_commit(struct BodyCache *bcache, const char *id);
 int mutt_bcache_del(struct BodyCache *bcache, const char *id);
@@ -143,6 +143,11 @@ void mutt_buffer_addstr(struct Buffer *buf, const char *s)
   mutt_buffer_add(buf, s, mutt_strlen(s));
 }
 
+void mutt_buffer_addstr_n(struct Buffer *buf, const char *s, size_t len)
+{
+  mutt_buffer_add(buf, s, len);
+}
+
 void mutt_buffer_addch(struct Buffer *buf, char c)
 {
   mutt_buffer_add(buf, &c, 1);
@@ -41,6 +41,7 @@ struct Buffer *mutt_buffer_from(char *seed);
 void mutt_buffer_free(struct Buffer **p);
 int mutt_buffer_printf(struct Buffer *buf, const char *fmt, ...);
 void mutt_buffer_addstr(struct Buffer *buf, const char *s);
+void mutt_buffer_addstr_n(struct Buffer *buf, const char *s, size_t len);
 void mutt_buffer_addch(struct Buffer *buf, char c);
 int mutt_extract_token(struct Buffer *dest, struct Buffer *tok, int flags);
 
@@ -19,10 +19,12 @@
 #include "config.h"
 #include <dirent.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <utime.h>
 #include "buffy.h"
 #include "buffer.h"
@@ -39,6 +41,9 @@
 #ifdef USE_SIDEBAR
 #include "sidebar.h"
 #endif
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
@@ -52,6 +57,19 @@ time_t BuffyDoneTime = 0; /* last time we knew for sure how much mail there was.
 static short BuffyCount = 0;  /* how many boxes with new mail */
 static short BuffyNotify = 0; /* # of unnotified new boxes */
 
+/* A round of checks can be interrupted by the user typing; the next call to
+ * mutt_buffy_check() carries on from where it stopped.  The counts are only
+ * published to BuffyCount and BuffyNotify once the round is complete. */
+static int BuffyResume = -1;     /* # of boxes the round has got through, or -1 */
+static int BuffyCheckStats = 0;  /* the round is counting messages, too */
+static short BuffyNewCount = 0;  /* BuffyCount, so far this round */
+static short BuffyNewNotify = 0; /* BuffyNotify, so far this round */
+
+/* A box that takes longer than this (ms) to check is left alone for a while,
+ * twice as long each time it's slow, up to BUFFY_MAX_BACKOFF seconds. */
+#define BUFFY_SLOW_CHECK 500
+#define BUFFY_MAX_BACKOFF 600
+
 /* Find the last message in the file.
  * upon success return 0. If no message found - return -1 */
 static int fseek_last_message(FILE *f)
@@ -166,10 +184,12 @@ static void buffy_free(struct Buffy **mailbox)
 /* Checks the specified maildir subdir (cur or new) for new mail or mail counts.
  * check_new:   if true, check for new mail.
  * check_stats: if true, count total, new, and flagged messages.
+ * stats:       the counts from last time; they're reused if the dir's unchanged
  * Returns 1 if the dir has new mail.
  */
 static int buffy_maildir_check_dir(struct Buffy *mailbox, const char *dir_name,
-                                   int check_new, int check_stats)
+                                   int check_new, int check_stats,
+                                   struct MaildirStats *stats)
 {
   char path[_POSIX_PATH_MAX];
   char msgpath[_POSIX_PATH_MAX];
@@ -177,28 +197,53 @@ static int buffy_maildir_check_dir(struct Buffy *mailbox, const char *dir_name,
   struct dirent *de = NULL;
   char *p = NULL;
   int rc = 0;
-  struct stat sb;
+  struct stat sb, msg_sb;
+  int have_sb;
+  time_t now;
+  int msg_count = 0, msg_unread = 0, msg_flagged = 0;
 
   snprintf(path, sizeof(path), "%s/%s", mailbox->path, dir_name);
 
+  have_sb = (check_stats || (check_new && option(OPTMAILCHECKRECENT))) &&
+            (stat(path, &sb) == 0);
+
   /* when $mail_check_recent is set, if the new/ directory hasn't been modified since
    * the user last exited the mailbox, then we know there is no recent mail.
    */
   if (check_new && option(OPTMAILCHECKRECENT))
   {
-    if (stat(path, &sb) == 0 && sb.st_mtime < mailbox->last_visited)
+    if (have_sb && sb.st_mtime < mailbox->last_visited)
     {
       rc = 0;
       check_new = 0;
     }
   }
 
+  /* nothing's been added, removed or renamed since we last counted */
+  if (check_stats && have_sb && stats->mtime && (sb.st_mtime == stats->mtime))
+  {
+    mailbox->msg_count += stats->msg_count;
+    mailbox->msg_unread += stats->msg_unread;
+    mailbox->msg_flagged += stats->msg_flagged;
+    check_stats = 0;
+
+    if (check_new && (stats->msg_unread == 0))
+      check_new = 0;
+    else if (check_new && !option(OPTMAILCHECKRECENT))
+    {
+      mailbox->new = true;
+      return 1;
+    }
+  }
+
   if (!(check_new || check_stats))
     return rc;
 
+  now = time(NULL);
   if ((dirp = opendir(path)) == NULL)
   {
     mailbox->magic = 0;
+    stats->mtime = 0;
     return 0;
   }
 
@@ -213,21 +258,21 @@ static int buffy_maildir_check_dir(struct Buffy *mailbox, const char *dir_name,
 
     if (check_stats)
     {
-      mailbox->msg_count++;
+      msg_count++;
       if (p && strchr(p + 3, 'F'))
-        mailbox->msg_flagged++;
+        msg_flagged++;
     }
     if (!p || !strchr(p + 3, 'S'))
     {
       if (check_stats)
-        mailbox->msg_unread++;
+        msg_unread++;
       if (check_new)
       {
         if (option(OPTMAILCHECKRECENT))
         {
           snprintf(msgpath, sizeof(msgpath), "%s/%s", path, de->d_name);
           /* ensure this message was received since leaving this mailbox */
-          if (stat(msgpath, &sb) == 0 && (sb.st_ctime <= mailbox->last_visited))
+          if (stat(msgpath, &msg_sb) == 0 && (msg_sb.st_ctime <= mailbox->last_visited))
             continue;
         }
         mailbox->new = true;
@@ -241,9 +286,79 @@ static int buffy_maildir_check_dir(struct Buffy *mailbox, const char *dir_name,
 
   closedir(dirp);
 
+  if (check_stats)
+  {
+    mailbox->msg_count += msg_count;
+    mailbox->msg_unread += msg_unread;
+    mailbox->msg_flagged += msg_flagged;
+
+    /* A change in the same second as we read the dir wouldn't alter its
+     * mtime, so don't trust that until it's in the past. */
+    stats->mtime = (have_sb && (sb.st_mtime < now)) ? sb.st_mtime : 0;
+    stats->msg_count = msg_count;
+    stats->msg_unread = msg_unread;
+    stats->msg_flagged = msg_flagged;
+  }
+
   return rc;
 }
 
+#ifdef USE_HCACHE
+/* Maildir counts are kept in the mailbox's header cache, under a key that
+ * can't be a message's filename, so they survive a restart. */
+#define MAILDIR_STATS_KEY "/MAILDIRSTATS"
+/* to be changed with struct MaildirStats */
+#define MAILDIR_STATS_MAGIC 0x4d445301
+
+/* What's stored under MAILDIR_STATS_KEY.  The header tells a record
+ * written by this version from one of another layout, whose size we
+ * can't know. */
+struct MaildirStatsRecord
+{
+  unsigned int magic;
+  unsigned int size; /* of stats */
+  struct MaildirStats stats[2];
+};
+
+static void buffy_maildir_fetch_stats(struct Buffy *mailbox)
+{
+  header_cache_t *hc = NULL;
+  void *data = NULL;
+  struct MaildirStatsRecord *rec = NULL;
+
+  hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
+  if (!hc)
+    return;
+
+  data = mutt_hcache_fetch_raw(hc, MAILDIR_STATS_KEY, mutt_strlen(MAILDIR_STATS_KEY));
+  rec = data;
+  if (rec && (rec->magic == MAILDIR_STATS_MAGIC) &&
+      (rec->size == sizeof(mailbox->maildir_stats)))
+    memcpy(mailbox->maildir_stats, rec->stats, sizeof(mailbox->maildir_stats));
+
+  mutt_hcache_free(hc, &data);
+  mutt_hcache_close(hc);
+}
+
+static void buffy_maildir_store_stats(struct Buffy *mailbox)
+{
+  header_cache_t *hc = NULL;
+  struct MaildirStatsRecord rec;
+
+  hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
+  if (!hc)
+    return;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.magic = MAILDIR_STATS_MAGIC;
+  rec.size = sizeof(rec.stats);
+  memcpy(rec.stats, mailbox->maildir_stats, sizeof(rec.stats));
+  mutt_hcache_store_raw(hc, MAILDIR_STATS_KEY, mutt_strlen(MAILDIR_STATS_KEY),
+                        &rec, sizeof(rec));
+  mutt_hcache_close(hc);
+}
+#endif
+
 /* Checks new mail for a maildir mailbox.
  * check_stats: if true, also count total, new, and flagged messages.
  * Returns 1 if the mailbox has new mail.
@@ -251,21 +366,34 @@ static int buffy_maildir_check_dir(struct Buffy *mailbox, const char *dir_name,
 static int buffy_maildir_check(struct Buffy *mailbox, int check_stats)
 {
   int rc, check_new = 1;
+  struct MaildirStats *stats = mailbox->maildir_stats;
+  struct MaildirStats old[2];
 
   if (check_stats)
   {
     mailbox->msg_count = 0;
     mailbox->msg_unread = 0;
     mailbox->msg_flagged = 0;
+
+#ifdef USE_HCACHE
+    if (!stats[0].mtime && !stats[1].mtime)
+      buffy_maildir_fetch_stats(mailbox);
+#endif
+    memcpy(old, stats, sizeof(old));
   }
 
-  rc = buffy_maildir_check_dir(mailbox, "new", check_new, check_stats);
+  rc = buffy_maildir_check_dir(mailbox, "new", check_new, check_stats, &stats[0]);
 
   check_new = !rc && option(OPTMAILDIRCHECKCUR);
   if (check_new || check_stats)
-    if (buffy_maildir_check_dir(mailbox, "cur", check_new, check_stats))
+    if (buffy_maildir_check_dir(mailbox, "cur", check_new, check_stats, &stats[1]))
       rc = 1;
 
+#ifdef USE_HCACHE
+  if (check_stats && (memcmp(old, stats, sizeof(old)) != 0))
+    buffy_maildir_store_stats(mailbox);
+#endif
+
   return rc;
 }
 
@@ -384,17 +512,17 @@ static void buffy_check(struct Buffy *tmp, struct stat *contex_sb, int check_sta
       case MUTT_MBOX:
       case MUTT_MMDF:
         if (buffy_mbox_check(tmp, &sb, check_stats) > 0)
-          BuffyCount++;
+          BuffyNewCount++;
         break;
 
       case MUTT_MAILDIR:
         if (buffy_maildir_check(tmp, check_stats) > 0)
-          BuffyCount++;
+          BuffyNewCount++;
         break;
 
       case MUTT_MH:
         if (mh_buffy(tmp, check_stats) > 0)
-          BuffyCount++;
+          BuffyNewCount++;
         break;
 #ifdef USE_NOTMUCH
       case MUTT_NOTMUCH:
@@ -404,7 +532,7 @@ static void buffy_check(struct Buffy *tmp, struct stat *contex_sb, int check_sta
         nm_nonctx_get_count(tmp->path, &tmp->msg_count, &tmp->msg_unread);
         if (tmp->msg_unread > 0)
         {
-          BuffyCount++;
+          BuffyNewCount++;
           tmp->new = true;
         }
         break;
@@ -423,7 +551,77 @@ static void buffy_check(struct Buffy *tmp, struct stat *contex_sb, int check_sta
   if (!tmp->new)
     tmp->notified = false;
   else if (!tmp->notified)
-    BuffyNotify++;
+    BuffyNewNotify++;
+}
+
+/* Has the user typed something that we should get back to? */
+static bool buffy_input_pending(void)
+{
+  struct pollfd pfd;
+
+  if (option(OPTNOCURSES))
+    return false;
+
+  pfd.fd = 0;
+  pfd.events = POLLIN;
+  return poll(&pfd, 1, 0) > 0;
+}
+
+/* Check the boxes in a list, skipping the first BuffyResume of the round and
+ * any that are backing off after being slow.
+ * n:       number of boxes in the lists before this one
+ * force:   don't stop for the keyboard
+ * Returns false if the round was interrupted.
+ */
+static bool buffy_check_list(struct Buffy *tmp, int *n, struct stat *contex_sb, int force)
+{
+  struct timeval start, stop;
+  int first = BuffyResume;
+  long ms;
+  time_t t = time(NULL);
+
+  for (; tmp; tmp = tmp->next, (*n)++)
+  {
+    if (*n < first)
+      continue;
+
+    /* check at least one box per call, so the round always finishes */
+    if (!force && (*n > first) && buffy_input_pending())
+    {
+      BuffyResume = *n;
+      return false;
+    }
+
+    if (tmp->next_check > t)
+    {
+      /* keep what we knew about it */
+      if (tmp->new)
+      {
+        BuffyNewCount++;
+        if (!tmp->notified)
+          BuffyNewNotify++;
+      }
+      continue;
+    }
+
+    gettimeofday(&start, NULL);
+    buffy_check(tmp, contex_sb, BuffyCheckStats);
+    gettimeofday(&stop, NULL);
+
+    ms = (stop.tv_sec - start.tv_sec) * 1000 + (stop.tv_usec - start.tv_usec) / 1000;
+    if (ms >= BUFFY_SLOW_CHECK)
+    {
+      tmp->backoff = tmp->backoff ? MIN(tmp->backoff * 2, BUFFY_MAX_BACKOFF) :
+                                    MAX(BuffyTimeout, 1) * 2;
+      tmp->next_check = stop.tv_sec + tmp->backoff;
+      mutt_debug(1, "%s took %ld ms to check, skipping it for %d seconds\n",
+                 tmp->path, ms, tmp->backoff);
+    }
+    else
+      tmp->backoff = 0;
+  }
+
+  return true;
 }
 
 /* fetch buffy object for given path, if present */
@@ -708,13 +906,15 @@ int mutt_parse_unvirtual_mailboxes(struct Buffer *path, struct Buffer *s,
 
 /* Check all Incoming for new mail and total/new/flagged messages
  * force: if true, ignore BuffyTimeout and check for new mail anyway
+ *
+ * Unless forced, the checks stop as soon as there's a key to read and the
+ * counts from the last complete round are returned.
  */
 int mutt_buffy_check(int force)
 {
-  struct Buffy *tmp = NULL;
   struct stat contex_sb;
   time_t t;
-  int check_stats = 0;
+  int n = 0;
   contex_sb.st_dev = 0;
   contex_sb.st_ino = 0;
 
@@ -733,22 +933,27 @@ int mutt_buffy_check(int force)
     return 0;
 #endif
   t = time(NULL);
-  if (!force && (t - BuffyTime < BuffyTimeout))
+  if (!force && (BuffyResume < 0) && (t - BuffyTime < BuffyTimeout))
     return BuffyCount;
 
-  if (option(OPTMAILCHECKSTATS) && (t - BuffyStatsTime >= BuffyCheckStatsInterval))
+  if (force || (BuffyResume < 0))
   {
-    check_stats = 1;
-    BuffyStatsTime = t;
-  }
+    BuffyCheckStats = 0;
+    if (option(OPTMAILCHECKSTATS) && (t - BuffyStatsTime >= BuffyCheckStatsInterval))
+    {
+      BuffyCheckStats = 1;
+      BuffyStatsTime = t;
+    }
 
-  BuffyTime = t;
-  BuffyCount = 0;
-  BuffyNotify = 0;
+    BuffyTime = t;
+    BuffyResume = 0;
+    BuffyNewCount = 0;
+    BuffyNewNotify = 0;
 
 #ifdef USE_IMAP
-  BuffyCount += imap_buffy_check(force, check_stats);
+    BuffyNewCount += imap_buffy_check(force, BuffyCheckStats);
 #endif
+  }
 
   /* check device ID and serial number instead of comparing paths */
   if (!Context || Context->magic == MUTT_IMAP || Context->magic == MUTT_POP
@@ -761,14 +966,16 @@ int mutt_buffy_check(int force)
     contex_sb.st_ino = 0;
   }
 
-  for (tmp = Incoming; tmp; tmp = tmp->next)
-    buffy_check(tmp, &contex_sb, check_stats);
-
+  if (!buffy_check_list(Incoming, &n, &contex_sb, force))
+    return BuffyCount;
 #ifdef USE_NOTMUCH
-  for (tmp = VirtIncoming; tmp; tmp = tmp->next)
-    buffy_check(tmp, &contex_sb, check_stats);
+  if (!buffy_check_list(VirtIncoming, &n, &contex_sb, force))
+    return BuffyCount;
 #endif
 
+  BuffyResume = -1;
+  BuffyCount = BuffyNewCount;
+  BuffyNotify = BuffyNewNotify;
   BuffyDoneTime = BuffyTime;
   return BuffyCount;
 }
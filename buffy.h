@@ -30,6 +30,19 @@ struct stat;
 #define MUTT_MAILBOXES   1
 #define MUTT_UNMAILBOXES 2
 
+/**
+ * struct MaildirStats - Message counts for a maildir's new/ or cur/
+ *
+ * They're reused until the directory's mtime changes.
+ */
+struct MaildirStats
+{
+  time_t mtime; /* of the directory when it was counted, 0 if unknown */
+  int msg_count;
+  int msg_unread;
+  int msg_flagged;
+};
+
 struct Buffy
 {
   char path[_POSIX_PATH_MAX];
@@ -50,6 +63,9 @@ struct Buffy
   bool newly_created;        /* mbox or mmdf just popped into existence */
   time_t last_visited;       /* time of last exit from this mailbox */
   time_t stats_last_checked; /* mtime of mailbox the last time stats where checked. */
+  time_t next_check;         /* a slow mailbox isn't checked again until then */
+  int backoff;               /* seconds it was last left alone for */
+  struct MaildirStats maildir_stats[2]; /* new/ and cur/ */
 };
 
 WHERE struct Buffy *Incoming INITVAL(0);
@@ -542,6 +542,7 @@ static int _mutt_parse_uncolor(struct Buffer *buf, struct Buffer *s, unsigned lo
   {
     mutt_set_menu_redraw_full(MENU_MAIN);
     /* force re-caching of index colors */
+    ColorIndexGeneration++;
     for (int i = 0; Context && i < Context->msgcount; i++)
       Context->hdrs[i]->pair = 0;
   }
@@ -565,6 +566,21 @@ int mutt_parse_unmono(struct Buffer *buf, struct Buffer *s, unsigned long data,
 }
 
 
+/**
+ * regex_uses_context - Does a regex look at the text before the match?
+ * @s: Regex
+ *
+ * Word boundaries, e.g. \< and \b, depend on the preceding character.
+ */
+static bool regex_uses_context(const char *s)
+{
+  for (; (s = strchr(s, '\\')) && s[1]; s += 2)
+    if (strchr("<>bB", s[1]))
+      return true;
+
+  return false;
+}
+
 static int add_pattern(struct ColorLine **top, const char *s, int sensitive, int fg,
                        int bg, int attr, struct Buffer *err, int is_index, int match)
 {
@@ -622,7 +638,9 @@ static int add_pattern(struct ColorLine **top, const char *s, int sensitive, int
         free_color_line(&tmp, 1);
         return -1;
       }
+      tmp->static_pattern = mutt_pattern_is_static(tmp->color_pattern);
       /* force re-caching of index colors */
+      ColorIndexGeneration++;
       for (int i = 0; Context && i < Context->msgcount; i++)
         Context->hdrs[i]->pair = 0;
     }
@@ -632,6 +650,8 @@ static int add_pattern(struct ColorLine **top, const char *s, int sensitive, int
       free_color_line(&tmp, 1);
       return -1;
     }
+    else
+      tmp->uses_context = regex_uses_context(s);
     tmp->next = *top;
     tmp->pattern = safe_strdup(s);
     tmp->match = match;
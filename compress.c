@@ -22,6 +22,15 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include "mutt.h"
 #include "compress.h"
 #include "context.h"
@@ -42,6 +51,28 @@ struct Header;
  * ctx->realpath == compressed file
  */
 
+#define COMP_BUF_SIZE (64 * 1024)
+
+/**
+ * struct CompressCodec - A built-in (de)compressor
+ *
+ * When $compress_builtin is set and the compressed file is in a format we
+ * know, the hook commands are replaced by these functions.  They stream the
+ * data from one file to the other without spawning a shell.
+ *
+ * All the formats allow several compressed streams to be concatenated, so an
+ * append only needs to compress the new messages.
+ */
+struct CompressCodec
+{
+  const char *name;            /* name of the format */
+  const char *suffix;          /* usual file suffix */
+  const unsigned char *magic;  /* first bytes of a compressed file */
+  size_t magiclen;             /* length of magic */
+  int (*decompress)(FILE *fin, FILE *fout, struct Progress *progress);
+  int (*compress)(FILE *fin, FILE *fout, struct Progress *progress);
+};
+
 /**
  * struct CompressInfo - Private data for compress
  *
@@ -52,6 +83,7 @@ struct CompressInfo
   const char *append;      /* append-hook command */
   const char *close;       /* close-hook  command */
   const char *open;        /* open-hook   command */
+  const struct CompressCodec *codec; /* built-in codec, instead of the hooks */
   off_t size;              /* size of the compressed file */
   struct MxOps *child_ops; /* callbacks of de-compressed file */
   int locked;              /* if realpath is locked */
@@ -175,7 +207,7 @@ static int setup_paths(struct Context *ctx)
  *      number: Size in bytes
  *      0:      On error
  */
-static int get_size(const char *path)
+static off_t get_size(const char *path)
 {
   if (!path)
     return 0;
@@ -205,6 +237,446 @@ static void store_size(const struct Context *ctx)
   ci->size = get_size(ctx->realpath);
 }
 
+/* Buffers shared by the codecs */
+static unsigned char CompIn[COMP_BUF_SIZE];
+static unsigned char CompOut[COMP_BUF_SIZE];
+
+/**
+ * read_chunk - Read the next chunk of input for a codec
+ * @fp:       File to read
+ * @progress: Progress bar to update (OPTIONAL)
+ *
+ * The data is read into CompIn.
+ *
+ * Returns:
+ *      number: Bytes read, 0 at the end of the file
+ *      -1:     Error
+ */
+static ssize_t read_chunk(FILE *fp, struct Progress *progress)
+{
+  size_t len = fread(CompIn, 1, sizeof(CompIn), fp);
+  if (ferror(fp))
+    return -1;
+
+  if (progress)
+    mutt_progress_update(progress, ftello(fp), -1);
+  return len;
+}
+
+/**
+ * write_chunk - Write the output of a codec
+ * @fp:  File to write
+ * @len: Number of bytes of CompOut to write
+ *
+ * Returns:
+ *       0: Success
+ *      -1: Error
+ */
+static int write_chunk(FILE *fp, size_t len)
+{
+  if (len && (fwrite(CompOut, 1, len, fp) != len))
+    return -1;
+  return 0;
+}
+
+#ifdef HAVE_ZLIB
+static const unsigned char GzipMagic[] = { 0x1f, 0x8b };
+
+/**
+ * gzip_decompress - Decompress a gzip file
+ *
+ * A gzip file can contain several members, which are decompressed in turn.
+ */
+static int gzip_decompress(FILE *fin, FILE *fout, struct Progress *progress)
+{
+  z_stream zs;
+  ssize_t len;
+  int rc = -1, ended = 0;
+
+  memset(&zs, 0, sizeof(zs));
+  /* 16: expect a gzip header */
+  if (inflateInit2(&zs, 15 + 16) != Z_OK)
+    return -1;
+
+  while (true)
+  {
+    if (zs.avail_in == 0)
+    {
+      len = read_chunk(fin, progress);
+      if (len < 0)
+        goto done;
+      if (len == 0)
+        break;
+      zs.next_in = CompIn;
+      zs.avail_in = len;
+    }
+
+    zs.next_out = CompOut;
+    zs.avail_out = sizeof(CompOut);
+    int zrc = inflate(&zs, Z_NO_FLUSH);
+    if ((zrc != Z_OK) && (zrc != Z_STREAM_END))
+    {
+      mutt_debug(1, "gzip_decompress: inflate failed: %s\n", NONULL(zs.msg));
+      goto done;
+    }
+    if (write_chunk(fout, sizeof(CompOut) - zs.avail_out) != 0)
+      goto done;
+
+    ended = (zrc == Z_STREAM_END);
+    if (ended && (inflateReset(&zs) != Z_OK))
+      goto done;
+  }
+
+  if (ended)
+    rc = 0;
+
+done:
+  inflateEnd(&zs);
+  return rc;
+}
+
+/**
+ * gzip_compress - Compress a file into a gzip member
+ */
+static int gzip_compress(FILE *fin, FILE *fout, struct Progress *progress)
+{
+  z_stream zs;
+  ssize_t len;
+  int flush, rc = -1;
+
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return -1;
+
+  do
+  {
+    len = read_chunk(fin, progress);
+    if (len < 0)
+      goto done;
+    flush = (len == 0) ? Z_FINISH : Z_NO_FLUSH;
+    zs.next_in = CompIn;
+    zs.avail_in = len;
+
+    do
+    {
+      zs.next_out = CompOut;
+      zs.avail_out = sizeof(CompOut);
+      if (deflate(&zs, flush) == Z_STREAM_ERROR)
+        goto done;
+      if (write_chunk(fout, sizeof(CompOut) - zs.avail_out) != 0)
+        goto done;
+    } while (zs.avail_out == 0);
+  } while (flush != Z_FINISH);
+
+  rc = 0;
+
+done:
+  deflateEnd(&zs);
+  return rc;
+}
+#endif /* HAVE_ZLIB */
+
+#ifdef HAVE_LZMA
+static const unsigned char XzMagic[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+
+/**
+ * xz_code - Run an lzma stream over a whole file
+ * @strm:     Initialised lzma encoder or decoder
+ * @fin:      File to read
+ * @fout:     File to write
+ * @progress: Progress bar to update (OPTIONAL)
+ *
+ * Returns:
+ *       0: Success
+ *      -1: Error
+ */
+static int xz_code(lzma_stream *strm, FILE *fin, FILE *fout, struct Progress *progress)
+{
+  lzma_action action = LZMA_RUN;
+  lzma_ret ret;
+  ssize_t len;
+
+  strm->next_out = CompOut;
+  strm->avail_out = sizeof(CompOut);
+
+  while (true)
+  {
+    if ((strm->avail_in == 0) && (action == LZMA_RUN))
+    {
+      len = read_chunk(fin, progress);
+      if (len < 0)
+        return -1;
+      if (len == 0)
+        action = LZMA_FINISH;
+      strm->next_in = CompIn;
+      strm->avail_in = len;
+    }
+
+    ret = lzma_code(strm, action);
+
+    if ((strm->avail_out == 0) || (ret == LZMA_STREAM_END))
+    {
+      if (write_chunk(fout, sizeof(CompOut) - strm->avail_out) != 0)
+        return -1;
+      strm->next_out = CompOut;
+      strm->avail_out = sizeof(CompOut);
+    }
+
+    if (ret == LZMA_STREAM_END)
+      return 0;
+    if (ret != LZMA_OK)
+    {
+      mutt_debug(1, "xz_code: lzma_code failed: %d\n", ret);
+      return -1;
+    }
+  }
+}
+
+/**
+ * xz_decompress - Decompress an xz file
+ *
+ * Concatenated xz streams are decompressed in turn.
+ */
+static int xz_decompress(FILE *fin, FILE *fout, struct Progress *progress)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+
+  if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+    return -1;
+
+  int rc = xz_code(&strm, fin, fout, progress);
+  lzma_end(&strm);
+  return rc;
+}
+
+/**
+ * xz_compress - Compress a file into an xz stream
+ */
+static int xz_compress(FILE *fin, FILE *fout, struct Progress *progress)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+
+  if (lzma_easy_encoder(&strm, 6, LZMA_CHECK_CRC64) != LZMA_OK)
+    return -1;
+
+  int rc = xz_code(&strm, fin, fout, progress);
+  lzma_end(&strm);
+  return rc;
+}
+#endif /* HAVE_LZMA */
+
+#ifdef HAVE_ZSTD
+static const unsigned char ZstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+/**
+ * zstd_decompress - Decompress a zstd file
+ *
+ * A zstd file can contain several frames, which are decompressed in turn.
+ */
+static int zstd_decompress(FILE *fin, FILE *fout, struct Progress *progress)
+{
+  ZSTD_DStream *ds = ZSTD_createDStream();
+  size_t zrc = 0;
+  ssize_t len;
+  int rc = -1;
+
+  if (!ds)
+    return -1;
+  if (ZSTD_isError(ZSTD_initDStream(ds)))
+    goto done;
+
+  while ((len = read_chunk(fin, progress)) > 0)
+  {
+    ZSTD_inBuffer in = { CompIn, len, 0 };
+    while (in.pos < in.size)
+    {
+      ZSTD_outBuffer out = { CompOut, sizeof(CompOut), 0 };
+      zrc = ZSTD_decompressStream(ds, &out, &in);
+      if (ZSTD_isError(zrc))
+      {
+        mutt_debug(1, "zstd_decompress: %s\n", ZSTD_getErrorName(zrc));
+        goto done;
+      }
+      if (write_chunk(fout, out.pos) != 0)
+        goto done;
+    }
+  }
+
+  /* zrc is 0 only if the last frame was complete */
+  if ((len == 0) && (zrc == 0))
+    rc = 0;
+
+done:
+  ZSTD_freeDStream(ds);
+  return rc;
+}
+
+/**
+ * zstd_compress - Compress a file into a zstd frame
+ */
+static int zstd_compress(FILE *fin, FILE *fout, struct Progress *progress)
+{
+  ZSTD_CStream *cs = ZSTD_createCStream();
+  size_t zrc;
+  ssize_t len;
+  int rc = -1;
+
+  if (!cs)
+    return -1;
+  if (ZSTD_isError(ZSTD_initCStream(cs, 3)))
+    goto done;
+
+  while ((len = read_chunk(fin, progress)) > 0)
+  {
+    ZSTD_inBuffer in = { CompIn, len, 0 };
+    while (in.pos < in.size)
+    {
+      ZSTD_outBuffer out = { CompOut, sizeof(CompOut), 0 };
+      zrc = ZSTD_compressStream(cs, &out, &in);
+      if (ZSTD_isError(zrc) || (write_chunk(fout, out.pos) != 0))
+        goto done;
+    }
+  }
+  if (len < 0)
+    goto done;
+
+  do
+  {
+    ZSTD_outBuffer out = { CompOut, sizeof(CompOut), 0 };
+    zrc = ZSTD_endStream(cs, &out);
+    if (ZSTD_isError(zrc) || (write_chunk(fout, out.pos) != 0))
+      goto done;
+  } while (zrc != 0);
+
+  rc = 0;
+
+done:
+  ZSTD_freeCStream(cs);
+  return rc;
+}
+#endif /* HAVE_ZSTD */
+
+/**
+ * Codecs - The built-in codecs we were compiled with
+ */
+static const struct CompressCodec Codecs[] = {
+#ifdef HAVE_ZLIB
+  { "gzip", ".gz", GzipMagic, sizeof(GzipMagic), gzip_decompress, gzip_compress },
+#endif
+#ifdef HAVE_LZMA
+  { "xz", ".xz", XzMagic, sizeof(XzMagic), xz_decompress, xz_compress },
+#endif
+#ifdef HAVE_ZSTD
+  { "zstd", ".zst", ZstdMagic, sizeof(ZstdMagic), zstd_decompress, zstd_compress },
+#endif
+  { NULL, NULL, NULL, 0, NULL, NULL },
+};
+
+/**
+ * find_codec - Find a built-in codec for a compressed file
+ * @path: Compressed file
+ *
+ * An existing file is recognised by its first bytes.  An empty or missing
+ * file (we're about to create it) is recognised by its suffix.
+ *
+ * Returns:
+ *      CompressCodec: Codec for the file
+ *      NULL:          The file must be handled by the hooks
+ */
+static const struct CompressCodec *find_codec(const char *path)
+{
+  unsigned char magic[8];
+  size_t len = 0;
+
+  if (!option(OPTCOMPRESSBUILTIN) || !path)
+    return NULL;
+
+  FILE *fp = fopen(path, "r");
+  if (fp)
+  {
+    len = fread(magic, 1, sizeof(magic), fp);
+    safe_fclose(&fp);
+  }
+
+  size_t plen = strlen(path);
+  for (const struct CompressCodec *codec = Codecs; codec->name; codec++)
+  {
+    if (len > 0)
+    {
+      if ((len >= codec->magiclen) && (memcmp(magic, codec->magic, codec->magiclen) == 0))
+        return codec;
+      continue;
+    }
+
+    size_t slen = strlen(codec->suffix);
+    if ((plen > slen) && (mutt_strcasecmp(path + plen - slen, codec->suffix) == 0))
+      return codec;
+  }
+
+  return NULL;
+}
+
+/**
+ * run_codec - Stream a file through a built-in codec
+ * @ctx:      Mailbox to work with
+ * @compress: If true, compress ctx->path into ctx->realpath, else decompress
+ * @append:   If true, append to the compressed file, rather than replace it
+ * @progress: Message to show the user
+ *
+ * Returns:
+ *      1: Success
+ *      0: Failure
+ */
+static int run_codec(struct Context *ctx, bool compress, bool append, const char *progress)
+{
+  struct CompressInfo *ci = ctx->compress_info;
+  const char *src = compress ? ctx->path : ctx->realpath;
+  const char *dest = compress ? ctx->realpath : ctx->path;
+  struct Progress prog;
+  int rc;
+
+  FILE *fin = fopen(src, "r");
+  if (!fin)
+  {
+    mutt_perror(src);
+    return 0;
+  }
+
+  FILE *fout = fopen(dest, append ? "a" : "w");
+  if (!fout)
+  {
+    mutt_perror(dest);
+    safe_fclose(&fin);
+    return 0;
+  }
+
+  if (!ctx->quiet)
+  {
+    char msg[SHORT_STRING];
+    snprintf(msg, sizeof(msg), progress, ctx->realpath);
+    mutt_progress_init(&prog, msg, MUTT_PROGRESS_SIZE, NetInc, get_size(src));
+  }
+
+  if (compress)
+    rc = ci->codec->compress(fin, fout, ctx->quiet ? NULL : &prog);
+  else
+    rc = ci->codec->decompress(fin, fout, ctx->quiet ? NULL : &prog);
+
+  safe_fclose(&fin);
+  if ((safe_fclose(&fout) != 0) && (rc == 0))
+    rc = -1;
+
+  if (rc != 0)
+  {
+    mutt_error(compress ? _("Error compressing %s (%s)") : _("Error decompressing %s (%s)"),
+               ctx->realpath, ci->codec->name);
+    return 0;
+  }
+
+  return 1;
+}
+
 /**
  * find_hook - Find a hook to match a path
  * @type: Type of hook, e.g. MUTT_CLOSEHOOK
@@ -267,6 +739,9 @@ static struct CompressInfo *set_compress_info(struct Context *ctx)
   ci->open = safe_strdup(o);
   ci->close = safe_strdup(c);
   ci->append = safe_strdup(a);
+  ci->codec = find_codec(ctx->path);
+  if (ci->codec)
+    mutt_debug(2, "set_compress_info: using built-in %s for %s\n", ci->codec->name, ctx->path);
 
   return ci;
 }
@@ -443,6 +918,50 @@ static int execute_command(struct Context *ctx, const char *command, const char
   return rc;
 }
 
+/**
+ * decompress_mailbox - Decompress ctx->realpath into ctx->path
+ * @ctx: Mailbox to work with
+ *
+ * Use the built-in codec, if we have one, otherwise run the open-hook.
+ *
+ * Returns:
+ *      1: Success
+ *      0: Failure
+ */
+static int decompress_mailbox(struct Context *ctx)
+{
+  struct CompressInfo *ci = ctx->compress_info;
+
+  if (ci->codec)
+    return run_codec(ctx, false, false, _("Decompressing %s"));
+
+  return execute_command(ctx, ci->open, _("Decompressing %s"));
+}
+
+/**
+ * compress_mailbox - Compress ctx->path into ctx->realpath
+ * @ctx:      Mailbox to work with
+ * @command:  Hook command, either the append-hook or the close-hook
+ * @progress: Message to show the user
+ *
+ * Use the built-in codec, if we have one, otherwise run the hook.  The
+ * codec appends a new compressed stream for the append-hook, so the existing
+ * messages aren't recompressed.
+ *
+ * Returns:
+ *      1: Success
+ *      0: Failure
+ */
+static int compress_mailbox(struct Context *ctx, const char *command, const char *progress)
+{
+  struct CompressInfo *ci = ctx->compress_info;
+
+  if (ci->codec)
+    return run_codec(ctx, true, (command == ci->append), progress);
+
+  return execute_command(ctx, command, progress);
+}
+
 /**
  * comp_open_mailbox - Open a compressed mailbox
  * @ctx: Mailbox to open
@@ -475,7 +994,7 @@ static int comp_open_mailbox(struct Context *ctx)
     goto or_fail;
   }
 
-  int rc = execute_command(ctx, ci->open, _("Decompressing %s"));
+  int rc = decompress_mailbox(ctx);
   if (rc == 0)
     goto or_fail;
 
@@ -547,7 +1066,7 @@ static int comp_open_append_mailbox(struct Context *ctx, int flags)
   /* Open the existing mailbox, unless we are appending */
   if (!ci->append && (get_size(ctx->realpath) > 0))
   {
-    int rc = execute_command(ctx, ci->open, _("Decompressing %s"));
+    int rc = decompress_mailbox(ctx);
     if (rc == 0)
     {
       mutt_error(_("Compress command failed: %s"), ci->open);
@@ -646,7 +1165,7 @@ static int comp_close_mailbox(struct Context *ctx)
       msg = _("Compressing %s...");
     }
 
-    int rc = execute_command(ctx, append, msg);
+    int rc = compress_mailbox(ctx, append, msg);
     if (rc == 0)
     {
       mutt_any_key_to_continue(NULL);
@@ -692,7 +1211,7 @@ static int comp_check_mailbox(struct Context *ctx, int *index_hint)
   if (!ops)
     return -1;
 
-  int size = get_size(ctx->realpath);
+  off_t size = get_size(ctx->realpath);
   if (size == ci->size)
     return 0;
 
@@ -702,7 +1221,7 @@ static int comp_check_mailbox(struct Context *ctx, int *index_hint)
     return -1;
   }
 
-  int rc = execute_command(ctx, ci->open, _("Decompressing %s"));
+  int rc = decompress_mailbox(ctx);
   store_size(ctx);
   unlock_realpath(ctx);
   if (rc == 0)
@@ -892,7 +1411,7 @@ static int comp_sync_mailbox(struct Context *ctx, int *index_hint)
   if (rc != 0)
     goto sync_cleanup;
 
-  rc = execute_command(ctx, ci->close, _("Compressing %s"));
+  rc = compress_mailbox(ctx, ci->close, _("Compressing %s"));
   if (rc == 0)
   {
     rc = -1;
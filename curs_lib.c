@@ -1095,6 +1095,69 @@ int mutt_multi_choice(char *prompt, char *letters)
   return choice;
 }
 
+/*
+ * mbrtowc_is_utf8 - Does mbrtowc() decode UTF-8?
+ *
+ * The C library's mbrtowc() follows the locale's codeset, which needn't be
+ * $charset; only mutt's own replacement follows $charset.
+ */
+static bool mbrtowc_is_utf8(void)
+{
+#ifdef HAVE_WC_FUNCS
+  static int utf8 = -1;
+
+  /* the locale is set once at startup */
+  if (utf8 < 0)
+    utf8 = mutt_is_utf8(nl_langinfo(CODESET));
+  return utf8;
+#else
+  return Charset_is_utf8;
+#endif
+}
+
+/*
+ * fast_mbrtowc - mbrtowc() for the strings we measure and format for the screen
+ *
+ * Most characters are ASCII, or in a UTF-8 locale, two or three bytes long.
+ * Those are decoded here; anything else, including malformed sequences, is
+ * left to mbrtowc() so that the results are the same.
+ */
+static inline size_t fast_mbrtowc(wchar_t *pwc, const char *s, size_t n, mbstate_t *ps)
+{
+  const unsigned char *u = (const unsigned char *) s;
+  wchar_t wc;
+
+  if (n && mbsinit(ps))
+  {
+    if (u[0] < 0x80)
+    {
+      *pwc = u[0];
+      return u[0] ? 1 : 0;
+    }
+    if (mbrtowc_is_utf8())
+    {
+      if ((u[0] >= 0xc2) && (u[0] <= 0xdf) && (n >= 2) && ((u[1] & 0xc0) == 0x80))
+      {
+        *pwc = ((u[0] & 0x1f) << 6) | (u[1] & 0x3f);
+        return 2;
+      }
+      if (((u[0] & 0xf0) == 0xe0) && (n >= 3) && ((u[1] & 0xc0) == 0x80) &&
+          ((u[2] & 0xc0) == 0x80))
+      {
+        wc = ((u[0] & 0x0f) << 12) | ((u[1] & 0x3f) << 6) | (u[2] & 0x3f);
+        /* not overlong, and not a surrogate */
+        if ((wc >= 0x800) && ((wc < 0xd800) || (wc > 0xdfff)))
+        {
+          *pwc = wc;
+          return 3;
+        }
+      }
+    }
+  }
+
+  return mbrtowc(pwc, s, n, ps);
+}
+
 /*
  * addwch would be provided by an up-to-date curses library
  */
@@ -1129,13 +1192,27 @@ void mutt_format_string(char *dest, size_t destlen, int min_width, int max_width
   char scratch[MB_LEN_MAX];
   mbstate_t mbstate1, mbstate2;
   int escaped = 0;
+  int verbatim; /* wc is still the character in s */
 
   memset(&mbstate1, 0, sizeof(mbstate1));
   memset(&mbstate2, 0, sizeof(mbstate2));
   --destlen;
   p = dest;
-  for (; n && (k = mbrtowc(&wc, s, n, &mbstate1)); s += k, n -= k)
+  for (; n && (k = fast_mbrtowc(&wc, s, n, &mbstate1)); s += k, n -= k)
   {
+    /* printable ASCII is copied as it is */
+    if ((k == 1) && (wc >= 0x20) && (wc < 0x7f) && !escaped)
+    {
+      if ((max_width < 1) || (destlen < 1))
+        break;
+      min_width--;
+      max_width--;
+      *p++ = wc;
+      destlen--;
+      continue;
+    }
+
+    verbatim = 1;
     if (k == (size_t)(-1) || k == (size_t)(-2))
     {
       if (k == (size_t)(-1) && errno == EILSEQ)
@@ -1143,6 +1220,7 @@ void mutt_format_string(char *dest, size_t destlen, int min_width, int max_width
 
       k = (k == (size_t)(-1)) ? 1 : n;
       wc = replacement_char();
+      verbatim = 0;
     }
     if (escaped)
     {
@@ -1162,20 +1240,39 @@ void mutt_format_string(char *dest, size_t destlen, int min_width, int max_width
     {
 #ifdef HAVE_ISWBLANK
       if (iswblank(wc))
+      {
+        verbatim = verbatim && (wc == ' ');
         wc = ' ';
+      }
       else
 #endif
           if (!IsWPrint(wc))
+      {
         wc = '?';
+        verbatim = 0;
+      }
       w = wcwidth(wc);
     }
     if (w >= 0)
     {
-      if (w > max_width || (k2 = wcrtomb(scratch, wc, &mbstate2)) > destlen)
+      if (w > max_width)
         break;
+      /* in UTF-8, an unchanged character encodes to the bytes we read */
+      if (verbatim && mbrtowc_is_utf8())
+      {
+        if (k > destlen)
+          break;
+        memcpy(p, s, k);
+        k2 = k;
+      }
+      else
+      {
+        if ((k2 = wcrtomb(scratch, wc, &mbstate2)) > destlen)
+          break;
+        strncpy(p, scratch, k2);
+      }
       min_width -= w;
       max_width -= w;
-      strncpy(p, scratch, k2);
       p += k2;
       destlen -= k2;
     }
@@ -1274,7 +1371,7 @@ void mutt_paddstr(int n, const char *s)
   mbstate_t mbstate;
 
   memset(&mbstate, 0, sizeof(mbstate));
-  for (; len && (k = mbrtowc(&wc, s, len, &mbstate)); s += k, len -= k)
+  for (; len && (k = fast_mbrtowc(&wc, s, len, &mbstate)); s += k, len -= k)
   {
     if (k == (size_t)(-1) || k == (size_t)(-2))
     {
@@ -1313,8 +1410,17 @@ size_t mutt_wstr_trunc(const char *src, size_t maxlen, size_t maxwid, size_t *wi
   n = mutt_strlen(src);
 
   memset(&mbstate, 0, sizeof(mbstate));
-  for (w = 0; n && (cl = mbrtowc(&wc, src, n, &mbstate)); src += cl, n -= cl)
+  for (w = 0; n && (cl = fast_mbrtowc(&wc, src, n, &mbstate)); src += cl, n -= cl)
   {
+    if ((cl == 1) && (wc >= 0x20) && (wc < 0x7f))
+    {
+      if ((l + 1 > maxlen) || (w + 1 > maxwid))
+        break;
+      l++;
+      w++;
+      continue;
+    }
+
     if (cl == (size_t)(-1) || cl == (size_t)(-2))
     {
       if (cl == (size_t)(-1))
@@ -1386,8 +1492,14 @@ int mutt_strwidth(const char *s)
   n = mutt_strlen(s);
 
   memset(&mbstate, 0, sizeof(mbstate));
-  for (w = 0; n && (k = mbrtowc(&wc, s, n, &mbstate)); s += k, n -= k)
+  for (w = 0; n && (k = fast_mbrtowc(&wc, s, n, &mbstate)); s += k, n -= k)
   {
+    if ((k == 1) && (wc >= 0x20) && (wc < 0x7f))
+    {
+      w++;
+      continue;
+    }
+
     if (*s == MUTT_SPECIAL_INDEX)
     {
       s += 2; /* skip the index coloring sequence */
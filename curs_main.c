@@ -573,8 +573,64 @@ void mutt_ts_icon(char *str)
   fprintf(stderr, "\033]1;%s\007", str);
 }
 
+/**
+ * index_format_volatile - Does an index format depend on the current time?
+ * @s: Format string, e.g. $index_format
+ *
+ * The lines of such a format (using "%<...>" for the current time, or a
+ * conditional "%?[" or "%?(" date) can't be cached.  "%<" also starts a
+ * nested conditional, "%<x?...>", which is as cacheable as "%?x?...?".
+ */
+static bool index_format_volatile(const char *s)
+{
+  while ((s = strchr(s, '%')))
+  {
+    s++;
+    if (*s == '%')
+    {
+      s++;
+      continue;
+    }
+
+    if ((*s == '?') || (*s == '<'))
+    {
+      if ((s[1] == '[') || (s[1] == '('))
+        return true;
+      /* anything else is a conditional only if '?' follows the expando */
+      if ((*s == '<') && s[1] && (s[2] != '?'))
+        return true;
+      continue;
+    }
+
+    while (*s && (isdigit((unsigned char) *s) || (*s == '-') || (*s == '.') || (*s == '=')))
+      s++;
+    if (*s == '<')
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * index_make_entry - Format a line of the index
+ * @s:    Buffer for the result
+ * @l:    Length of the buffer
+ * @menu: Index menu
+ * @num:  Virtual number of the message
+ *
+ * The formatted line is cached in the Header, so paging through a large
+ * mailbox doesn't expand $index_format again for each row.  The cache is
+ * dropped for a single message when its flags, score, label or tags change,
+ * and for all messages when IndexGeneration is bumped (sorting, threading,
+ * limiting, any config command, a full redraw).
+ */
 void index_make_entry(char *s, size_t l, struct Menu *menu, int num)
 {
+  static int cols = -1;
+  static char *fmt = NULL;
+  static unsigned int fmt_gen = 0;
+  static bool fmt_volatile = false;
+
   if (!Context || !menu || (num < 0) || (num >= Context->hdrmax))
     return;
 
@@ -638,7 +694,38 @@ void index_make_entry(char *s, size_t l, struct Menu *menu, int num)
     }
   }
 
-  _mutt_make_string(s, l, NONULL(HdrFmt), Context, h, flag);
+  /* the width of the line may be used for padding */
+  if (menu->indexwin->cols != cols)
+  {
+    cols = menu->indexwin->cols;
+    IndexGeneration++;
+  }
+
+  if (h->index_line && (h->index_gen == IndexGeneration) && (h->index_flags == flag))
+  {
+    strfcpy(s, h->index_line, l);
+    return;
+  }
+
+  /* mutt_FormatString() rewrites "%?" conditionals in place, so format a
+   * private copy of $index_format and check it before that happens */
+  if (fmt_gen != IndexGeneration)
+  {
+    mutt_str_replace(&fmt, HdrFmt);
+    fmt_volatile = index_format_volatile(NONULL(fmt));
+    fmt_gen = IndexGeneration;
+  }
+
+  _mutt_make_string(s, l, NONULL(fmt), Context, h, flag);
+
+  if (fmt_volatile)
+    FREE(&h->index_line);
+  else
+  {
+    mutt_str_replace(&h->index_line, s);
+    h->index_gen = IndexGeneration;
+    h->index_flags = flag;
+  }
 }
 
 int index_color(int index_no)
@@ -824,6 +911,8 @@ static void index_menu_redraw(struct Menu *menu)
 
   if (menu->redraw & REDRAW_FULL)
   {
+    /* we may be back from the pager, an editor or a resize */
+    IndexGeneration++;
     menu_redraw_full(menu);
     mutt_show_error();
   }
@@ -1852,31 +1941,24 @@ int mutt_index_menu(void)
         }
         if (tag)
         {
-          char msgbuf[STRING];
-          struct Progress progress;
+          struct Header **hdrs = safe_calloc(Context->tagged + 1, sizeof(struct Header *));
           int px;
 
-          if (!Context->quiet)
+          for (px = 0, j = 0; (j < Context->vcount) && (px < Context->tagged); j++)
           {
-            snprintf(msgbuf, sizeof(msgbuf), _("Update labels..."));
-            mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, 1, Context->tagged);
+            if (Context->hdrs[Context->v2r[j]]->tagged)
+              hdrs[px++] = Context->hdrs[Context->v2r[j]];
           }
-          nm_longrun_init(Context, true);
-          for (px = 0, j = 0; j < Context->vcount; j++)
+
+          /* one database transaction for all the messages */
+          nm_modify_messages_tags(Context, hdrs, px, buf);
+          if (op == OP_MAIN_MODIFY_LABELS_THEN_HIDE)
           {
-            if (Context->hdrs[Context->v2r[j]]->tagged)
-            {
-              if (!Context->quiet)
-                mutt_progress_update(&progress, ++px, -1);
-              nm_modify_message_tags(Context, Context->hdrs[Context->v2r[j]], buf);
-              if (op == OP_MAIN_MODIFY_LABELS_THEN_HIDE)
-              {
-                Context->hdrs[Context->v2r[j]]->quasi_deleted = true;
-                Context->changed = true;
-              }
-            }
+            for (j = 0; j < px; j++)
+              hdrs[j]->quasi_deleted = true;
+            Context->changed = true;
           }
-          nm_longrun_done(Context);
+          FREE(&hdrs);
           menu->redraw = REDRAW_STATUS | REDRAW_INDEX;
         }
         else
@@ -3271,21 +3353,57 @@ int mutt_index_menu(void)
   return close;
 }
 
+/**
+ * mutt_set_header_color - Select a colour for a message in the index
+ * @ctx:    Mailbox
+ * @curhdr: Message
+ *
+ * The first "color index" rule to match wins.  The results of the static
+ * rules (those depending only on the message's contents) are remembered in
+ * the Header, so a change of flags only runs the other rules again.  Only the
+ * first rules, up to the number of bits in a long, are remembered.
+ */
 void mutt_set_header_color(struct Context *ctx, struct Header *curhdr)
 {
   struct ColorLine *color = NULL;
   struct PatternCache cache;
+  unsigned long bit = 1;
+  bool match;
 
   if (!curhdr)
     return;
 
   memset(&cache, 0, sizeof(cache));
 
-  for (color = ColorIndexList; color; color = color->next)
-    if (mutt_pattern_exec(color->color_pattern, MUTT_MATCH_FULL_ADDRESS, ctx, curhdr, &cache))
+  if (curhdr->color_gen != ColorIndexGeneration)
+  {
+    curhdr->color_known = 0;
+    curhdr->color_match = 0;
+    curhdr->color_gen = ColorIndexGeneration;
+  }
+
+  /* bit becomes 0 after the last cacheable rule */
+  for (color = ColorIndexList; color; color = color->next, bit <<= 1)
+  {
+    if (color->static_pattern && (curhdr->color_known & bit))
+      match = (curhdr->color_match & bit);
+    else
+    {
+      match = (mutt_pattern_exec(color->color_pattern, MUTT_MATCH_FULL_ADDRESS,
+                                 ctx, curhdr, &cache) != 0);
+      if (color->static_pattern)
+      {
+        curhdr->color_known |= bit;
+        if (match)
+          curhdr->color_match |= bit;
+      }
+    }
+
+    if (match)
     {
       curhdr->pair = color->pair;
       return;
     }
+  }
   curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
 }
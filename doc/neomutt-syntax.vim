@@ -104,7 +104,7 @@ syn match   muttrcKeyName	contained "<F[0-9]\+>"
 syn keyword muttrcVarBool	skipwhite contained
 			\ allow_8bit allow_ansi arrow_cursor ascii_chars askbcc askcc attach_split
 			\ auto_tag autoedit beep beep_new bounce_delivered braille_friendly
-			\ check_mbox_size check_new collapse_unread confirmappend confirmcreate
+			\ check_mbox_size check_new collapse_unread compress_builtin confirmappend confirmcreate
 			\ crypt_autoencrypt crypt_autopgp crypt_autosign crypt_autosmime
 			\ crypt_confirmhook crypt_opportunistic_encrypt crypt_replyencrypt
 			\ crypt_replysign crypt_replysignencrypted crypt_timestamp crypt_use_gpgme
@@ -114,8 +114,8 @@ syn keyword muttrcVarBool	skipwhite contained
 			\ forward_quote hdrs header help hidden_host hide_limited hide_missing
 			\ hide_thread_subject hide_top_limited hide_top_missing honor_disposition
 			\ idn_decode idn_encode ignore_linear_white_space ignore_list_reply_to
-			\ imap_check_subscribed imap_list_subscribed imap_passive imap_peek
-			\ imap_servernoise implicit_autoview include_onlyfirst keep_flagged
+			\ imap_check_subscribed imap_list_subscribed imap_notify imap_passive imap_peek
+			\ imap_servernoise imap_server_sort implicit_autoview include_onlyfirst keep_flagged
 			\ mail_check_recent mail_check_stats mailcap_sanitize maildir_check_cur
 			\ maildir_header_cache_verify maildir_trash mark_old markers menu_move_off
 			\ menu_scroll message_cache_clean meta_key metoo mh_purge mime_forward_decode
@@ -141,7 +141,7 @@ syn keyword muttrcVarBool	skipwhite contained
 syn keyword muttrcVarBool	skipwhite contained
 			\ noallow_8bit noallow_ansi noarrow_cursor noascii_chars noaskbcc noaskcc noattach_split
 			\ noauto_tag noautoedit nobeep nobeep_new nobounce_delivered nobraille_friendly
-			\ nocheck_mbox_size nocheck_new nocollapse_unread noconfirmappend noconfirmcreate
+			\ nocheck_mbox_size nocheck_new nocollapse_unread nocompress_builtin noconfirmappend noconfirmcreate
 			\ nocrypt_autoencrypt nocrypt_autopgp nocrypt_autosign nocrypt_autosmime
 			\ nocrypt_confirmhook nocrypt_opportunistic_encrypt nocrypt_replyencrypt
 			\ nocrypt_replysign nocrypt_replysignencrypted nocrypt_timestamp nocrypt_use_gpgme
@@ -151,8 +151,8 @@ syn keyword muttrcVarBool	skipwhite contained
 			\ noforward_quote nohdrs noheader nohelp nohidden_host nohide_limited nohide_missing
 			\ nohide_thread_subject nohide_top_limited nohide_top_missing nohonor_disposition
 			\ noidn_decode noidn_encode noignore_linear_white_space noignore_list_reply_to
-			\ noimap_check_subscribed noimap_list_subscribed noimap_passive noimap_peek
-			\ noimap_servernoise noimplicit_autoview noinclude_onlyfirst nokeep_flagged
+			\ noimap_check_subscribed noimap_list_subscribed noimap_notify noimap_passive noimap_peek
+			\ noimap_servernoise noimap_server_sort noimplicit_autoview noinclude_onlyfirst nokeep_flagged
 			\ nomail_check_recent nomail_check_stats nomailcap_sanitize nomaildir_check_cur
 			\ nomaildir_header_cache_verify nomaildir_trash nomark_old nomarkers nomenu_move_off
 			\ nomenu_scroll nomessage_cache_clean nometa_key nometoo nomh_purge nomime_forward_decode
@@ -178,7 +178,7 @@ syn keyword muttrcVarBool	skipwhite contained
 syn keyword muttrcVarBool	skipwhite contained
 			\ invallow_8bit invallow_ansi invarrow_cursor invascii_chars invaskbcc invaskcc invattach_split
 			\ invauto_tag invautoedit invbeep invbeep_new invbounce_delivered invbraille_friendly
-			\ invcheck_mbox_size invcheck_new invcollapse_unread invconfirmappend invconfirmcreate
+			\ invcheck_mbox_size invcheck_new invcollapse_unread invcompress_builtin invconfirmappend invconfirmcreate
 			\ invcrypt_autoencrypt invcrypt_autopgp invcrypt_autosign invcrypt_autosmime
 			\ invcrypt_confirmhook invcrypt_opportunistic_encrypt invcrypt_replyencrypt
 			\ invcrypt_replysign invcrypt_replysignencrypted invcrypt_timestamp invcrypt_use_gpgme
@@ -188,8 +188,8 @@ syn keyword muttrcVarBool	skipwhite contained
 			\ invforward_quote invhdrs invheader invhelp invhidden_host invhide_limited invhide_missing
 			\ invhide_thread_subject invhide_top_limited invhide_top_missing invhonor_disposition
 			\ invidn_decode invidn_encode invignore_linear_white_space invignore_list_reply_to
-			\ invimap_check_subscribed invimap_list_subscribed invimap_passive invimap_peek
-			\ invimap_servernoise invimplicit_autoview invinclude_onlyfirst invkeep_flagged
+			\ invimap_check_subscribed invimap_list_subscribed invimap_notify invimap_passive invimap_peek
+			\ invimap_servernoise invimap_server_sort invimplicit_autoview invinclude_onlyfirst invkeep_flagged
 			\ invmail_check_recent invmail_check_stats invmailcap_sanitize invmaildir_check_cur
 			\ invmaildir_header_cache_verify invmaildir_trash invmark_old invmarkers invmenu_move_off
 			\ invmenu_scroll invmessage_cache_clean invmeta_key invmetoo invmh_purge invmime_forward_decode
@@ -234,7 +234,8 @@ syn keyword muttrcVarQuad	skipwhite contained
 			\ nextgroup=muttrcVPrefix,muttrcVarBool,muttrcVarQuad,muttrcVarNum,muttrcVarStr
 
 syn keyword muttrcVarNum	skipwhite contained
-			\ connect_timeout history imap_keepalive imap_pipeline_depth mail_check
+			\ connect_timeout history imap_keepalive imap_pipeline_depth imap_poll_connections
+			\ imap_prefetch imap_prefetch_size mail_check message_cache_size
 			\ mail_check_stats_interval menu_context net_inc pager_context pager_index_lines
 			\ pgp_timeout pop_checkinterval read_inc save_history score_threshold_delete
 			\ score_threshold_flag score_threshold_read search_context sendmail_wait
@@ -364,7 +365,7 @@ syn keyword muttrcVarStr	contained skipwhite
 			\ header_cache_compress header_cache_pagesize history_file hostname
 			\ imap_authenticators imap_delim_chars imap_headers imap_idle imap_login
 			\ imap_pass imap_user indent_str indent_string ispell locale mailcap_path mask
-			\ mbox mbox_type message_cachedir mh_seq_flagged mh_seq_replied mh_seq_unseen
+			\ mbox mbox_type message_cache_backend message_cachedir mh_seq_flagged mh_seq_replied mh_seq_unseen
 			\ mixmaster msg_format pager pgp_decryption_okay pgp_good_sign
 			\ pgp_mime_signature_description pgp_mime_signature_filename pgp_sign_as
 			\ pgp_sort_keys pipe_sep pop_authenticators pop_host pop_pass pop_user
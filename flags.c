@@ -310,6 +310,7 @@ void _mutt_set_flag(struct Context *ctx, struct Header *h, int flag, int bf, int
   if (update)
   {
     mutt_set_header_color(ctx, h);
+    FREE(&h->index_line);
 #ifdef USE_SIDEBAR
     mutt_set_current_menu_redraw(REDRAW_SIDEBAR);
 #endif
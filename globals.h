@@ -87,7 +87,9 @@ WHERE char *Ispell;
 WHERE char *MailcapPath;
 WHERE char *Maildir;
 #if defined(USE_IMAP) || defined(USE_POP) || defined(USE_NNTP)
+WHERE char *MessageCacheBackend;
 WHERE char *MessageCachedir;
+WHERE short MessageCacheSize;
 #endif
 #ifdef USE_HCACHE
 WHERE char *HeaderCache;
@@ -233,6 +235,13 @@ extern unsigned char QuadOptions[];
 
 WHERE unsigned short Counter INITVAL(0);
 
+/* Bumped whenever the cached index lines (Header.index_line) may be stale */
+WHERE unsigned int IndexGeneration INITVAL(1);
+/* Bumped whenever the cached sidebar entries (SbEntry.display) may be stale */
+WHERE unsigned int SidebarGeneration INITVAL(1);
+/* Bumped whenever the list of "color index" rules changes */
+WHERE unsigned int ColorIndexGeneration INITVAL(1);
+
 #ifdef USE_NNTP
 WHERE short NewsPollTimeout;
 WHERE short NntpContext;
@@ -272,6 +281,9 @@ WHERE struct List *SidebarWhitelist INITVAL(0);
 #ifdef USE_IMAP
 WHERE short ImapKeepalive;
 WHERE short ImapPipelineDepth;
+WHERE short ImapPollConnections;
+WHERE short ImapPrefetch;
+WHERE short ImapPrefetchSize;
 #endif
 
 /* flags for received signals */
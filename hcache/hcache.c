@@ -671,10 +671,15 @@ static void *hcache_dump(header_cache_t *h, struct Header *header, int *off,
   nh.num_hidden = 0;
   nh.recipient = 0;
   nh.pair = 0;
+  nh.color_known = 0;
+  nh.color_match = 0;
+  nh.color_gen = 0;
   nh.attach_valid = false;
   nh.path = NULL;
   nh.tree = NULL;
   nh.thread = NULL;
+  nh.index_line = NULL;
+  nh.index_gen = 0;
 #ifdef MIXMASTER
   nh.chain = NULL;
 #endif
@@ -847,7 +852,10 @@ void *mutt_hcache_fetch_raw(header_cache_t *h, const char *key, size_t keylen)
   if (!h || !ops)
     return NULL;
 
-  keylen = snprintf(path, sizeof(path), "%s%s", h->folder, key);
+  /* a truncated key would be another message's */
+  if (snprintf(path, sizeof(path), "%s%s", h->folder, key) >= sizeof(path))
+    return NULL;
+  keylen = strlen(path);
 
   return ops->fetch(h->ctx, path, keylen);
 }
@@ -889,7 +897,10 @@ int mutt_hcache_store_raw(header_cache_t *h, const char *key, size_t keylen,
   if (!h || !ops)
     return -1;
 
-  keylen = snprintf(path, sizeof(path), "%s%s", h->folder, key);
+  /* a truncated key would be another message's */
+  if (snprintf(path, sizeof(path), "%s%s", h->folder, key) >= sizeof(path))
+    return -1;
+  keylen = strlen(path);
 
   return ops->store(h->ctx, path, keylen, data, dlen);
 }
@@ -902,7 +913,10 @@ int mutt_hcache_delete(header_cache_t *h, const char *key, size_t keylen)
   if (!h)
     return -1;
 
-  keylen = snprintf(path, sizeof(path), "%s%s", h->folder, key);
+  /* a truncated key would be another message's */
+  if (snprintf(path, sizeof(path), "%s%s", h->folder, key) >= sizeof(path))
+    return -1;
+  keylen = strlen(path);
 
   return ops->delete (h->ctx, path, keylen);
 }
@@ -72,6 +72,11 @@ struct Header
   short recipient;    /* user_is_recipient()'s return value, cached */
 
   int pair;           /* color-pair to use when displaying in the index */
+  /* cached results of the static "color index" rules, one bit per rule,
+   * valid if color_gen == ColorIndexGeneration */
+  unsigned long color_known;
+  unsigned long color_match;
+  unsigned int color_gen;
 
   time_t date_sent;   /* time when the message was sent (UTC) */
   time_t received;    /* time when the message was placed in the mailbox */
@@ -88,6 +93,10 @@ struct Header
   char *tree; /* character string to print thread tree */
   struct MuttThread *thread;
 
+  char *index_line;       /* cached $index_format line, see index_make_entry() */
+  unsigned int index_gen; /* IndexGeneration when index_line was made */
+  int index_flags;        /* format flags index_line was made with */
+
   /* Number of qualifying attachments in message, if attach_valid */
   short attach_total;
 
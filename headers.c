@@ -278,6 +278,7 @@ static int label_message(struct Context *ctx, struct Header *hdr, char *new)
   mutt_str_replace(&hdr->env->x_label, new);
   if (hdr->env->x_label != NULL)
     label_ref_inc(ctx, hdr->env->x_label);
+  FREE(&hdr->index_line);
 
   return hdr->changed = hdr->xlabel_changed = true;
 }
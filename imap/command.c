@@ -52,7 +52,8 @@
 static const char *const Capabilities[] = {
   "IMAP4",         "IMAP4rev1",   "STATUS",         "ACL",      "NAMESPACE",
   "AUTH=CRAM-MD5", "AUTH=GSSAPI", "AUTH=ANONYMOUS", "STARTTLS", "LOGINDISABLED",
-  "IDLE",          "SASL-IR",     "ENABLE",         NULL,
+  "IDLE",          "SASL-IR",     "ENABLE",         "NOTIFY",   "SORT",
+  NULL,
 };
 
 static bool cmd_queue_full(struct ImapData *idata)
@@ -498,6 +499,22 @@ static void cmd_parse_search(struct ImapData *idata, const char *s)
   }
 }
 
+/* cmd_parse_sort: collect the UIDs of a UID SORT response, in order */
+static void cmd_parse_sort(struct ImapData *idata, const char *s)
+{
+  mutt_debug(2, "Handling SORT\n");
+
+  if (idata->cmdtype != IMAP_CT_SORT)
+    return;
+
+  while ((s = imap_next_word((char *) s)) && *s != '\0')
+  {
+    if ((idata->sort_count % 256) == 0)
+      safe_realloc(&idata->sort_uids, (idata->sort_count + 256) * sizeof(unsigned int));
+    idata->sort_uids[idata->sort_count++] = (unsigned int) atoi(s);
+  }
+}
+
 /* first cut: just do buffy update. Later we may wish to cache all
  * mailbox information, even that not desired by buffy */
 static void cmd_parse_status(struct ImapData *idata, char *s)
@@ -512,6 +529,7 @@ static void cmd_parse_status(struct ImapData *idata, char *s)
   long litlen;
   short new = 0;
   short new_msg_count = 0;
+  bool have_unseen = false;
 
   mailbox = imap_next_word(s);
 
@@ -562,7 +580,10 @@ static void cmd_parse_status(struct ImapData *idata, char *s)
     else if (ascii_strncmp("UIDVALIDITY", s, 11) == 0)
       status->uidvalidity = count;
     else if (ascii_strncmp("UNSEEN", s, 6) == 0)
+    {
       status->unseen = count;
+      have_unseen = true;
+    }
 
     s = value;
     if (*s && *s != ')')
@@ -574,6 +595,10 @@ static void cmd_parse_status(struct ImapData *idata, char *s)
       status->name, status->uidvalidity, status->uidnext, status->messages,
       status->recent, status->unseen);
 
+  /* NOTIFY events may only report MESSAGES and UIDNEXT. Remember that the
+   * unseen count is out of date so imap_buffy_check() asks again. */
+  status->current = have_unseen;
+
   /* caller is prepared to handle the result herself */
   if (idata->cmddata && idata->cmdtype == IMAP_CT_STATUS)
   {
@@ -734,6 +759,8 @@ static int cmd_handle_untagged(struct ImapData *idata)
     cmd_parse_myrights(idata, s);
   else if (ascii_strncasecmp("SEARCH", s, 6) == 0)
     cmd_parse_search(idata, s);
+  else if (ascii_strncasecmp("SORT", s, 4) == 0)
+    cmd_parse_sort(idata, s);
   else if (ascii_strncasecmp("STATUS", s, 6) == 0)
     cmd_parse_status(idata, s);
   else if (ascii_strncasecmp("ENABLED", s, 7) == 0)
@@ -213,20 +213,24 @@ void imap_logout_all(void)
   }
 }
 
-/* imap_read_literal: read bytes bytes from server into file. Not explicitly
- *   buffered, relies on FILE buffering. NOTE: strips \r from \r\n.
+/* read_literal: read bytes bytes from server, in chunks taken straight off
+ *   the connection buffer, into either fp or b. NOTE: strips \r from \r\n.
  *   Apparently even literals use \r\n-terminated strings ?! */
-int imap_read_literal(FILE *fp, struct ImapData *idata, long bytes, struct Progress *pbar)
+static int read_literal(FILE *fp, struct Buffer *b, struct ImapData *idata,
+                        long bytes, struct Progress *pbar)
 {
-  char c;
-
-  int r = 0;
+  char chunk[HUGE_STRING];
+  char out[HUGE_STRING + 1];
+  bool cr = false; /* chunk ended in \r, still undecided */
+  long pos = 0;
+  int n, olen;
 
   mutt_debug(2, "imap_read_literal: reading %ld bytes\n", bytes);
 
-  for (long pos = 0; pos < bytes; pos++)
+  while (pos < bytes)
   {
-    if (mutt_socket_readchar(idata->conn, &c) != 1)
+    n = mutt_socket_read(idata->conn, chunk, MIN(bytes - pos, sizeof(chunk)));
+    if (n <= 0)
     {
       mutt_debug(1, "imap_read_literal: error during read, %ld bytes read\n", pos);
       idata->status = IMAP_FATAL;
@@ -234,30 +238,55 @@ int imap_read_literal(FILE *fp, struct ImapData *idata, long bytes, struct Progr
       return -1;
     }
 
-    if (r == 1 && c != '\n')
-      fputc('\r', fp);
+#ifdef DEBUG
+    if (debuglevel >= IMAP_LOG_LTRL)
+      fwrite(chunk, 1, n, debugfile);
+#endif
 
-    if (c == '\r')
+    olen = 0;
+    for (int i = 0; i < n; i++)
     {
-      r = 1;
-      continue;
+      if (cr && chunk[i] != '\n')
+        out[olen++] = '\r';
+      cr = (chunk[i] == '\r');
+      if (!cr)
+        out[olen++] = chunk[i];
     }
-    else
-      r = 0;
 
-    fputc(c, fp);
+    if (fp)
+      fwrite(out, 1, olen, fp);
+    else
+      mutt_buffer_addstr_n(b, out, olen);
 
-    if (pbar && !(pos % 1024))
+    pos += n;
+    if (pbar)
       mutt_progress_update(pbar, pos, -1);
-#ifdef DEBUG
-    if (debuglevel >= IMAP_LOG_LTRL)
-      fputc(c, debugfile);
-#endif
+  }
+
+  /* a lone \r at the very end of the literal is data, not a line ending */
+  if (cr)
+  {
+    if (fp)
+      fputc('\r', fp);
+    else
+      mutt_buffer_addch(b, '\r');
   }
 
   return 0;
 }
 
+/* imap_read_literal: read bytes bytes from server into file. */
+int imap_read_literal(FILE *fp, struct ImapData *idata, long bytes, struct Progress *pbar)
+{
+  return read_literal(fp, NULL, idata, bytes, pbar);
+}
+
+/* imap_read_literal_buf: read bytes bytes from server, appending them to b. */
+int imap_read_literal_buf(struct Buffer *b, struct ImapData *idata, long bytes)
+{
+  return read_literal(NULL, b, idata, bytes, NULL);
+}
+
 /* imap_expunge_mailbox: Purge IMAP portion of expunged messages from the
  *   context. Must not be done while something has a handle on any headers
  *   (eg inside pager or editor). That is, check IMAP_REOPEN_ALLOW. */
@@ -267,6 +296,9 @@ void imap_expunge_mailbox(struct ImapData *idata)
   int cacheno;
   short old_sort;
 
+  FREE(&idata->sort_uids);
+  idata->sort_count = 0;
+
 #ifdef USE_HCACHE
   idata->hcache = imap_hcache_open(idata, NULL);
 #endif
@@ -371,6 +403,8 @@ struct ImapData *imap_conn_find(const struct Account *account, int flags)
     }
     if (flags & MUTT_IMAP_CONN_NOSELECT && idata && idata->state >= IMAP_SELECTED)
       continue;
+    if (flags & MUTT_IMAP_CONN_NEWCONN && idata)
+      continue;
     if (idata && idata->status == IMAP_FATAL)
       continue;
     break;
@@ -514,6 +548,8 @@ bail:
 
 void imap_close_connection(struct ImapData *idata)
 {
+  bool authenticated = (idata->state >= IMAP_AUTHENTICATED);
+
   if (idata->state != IMAP_DISCONNECTED)
   {
     mutt_socket_close(idata->conn);
@@ -521,6 +557,13 @@ void imap_close_connection(struct ImapData *idata)
   }
   idata->seqno = idata->nextcmd = idata->lastcmd = idata->status = false;
   memset(idata->cmds, 0, sizeof(struct ImapCommand) * idata->cmdslots);
+
+  /* The server forgets the NOTIFY registration with the connection, and
+   * any events sent meanwhile are lost: register again and ask STATUS
+   * once the connection has been reopened. */
+  FREE(&idata->notify_mboxes);
+  if (authenticated)
+    imap_mboxcache_stale(idata);
 }
 
 /* imap_get_flags: Make a simple list out of a FLAGS response.
@@ -1411,6 +1454,9 @@ int imap_close_mailbox(struct Context *ctx)
     idata->ctx = NULL;
 
     hash_destroy(&idata->uid_hash, NULL);
+    idata->prefetch_uid = 0;
+    FREE(&idata->sort_uids);
+    idata->sort_count = 0;
     FREE(&idata->msn_index);
     idata->msn_index_size = 0;
     idata->max_msn = 0;
@@ -1536,18 +1582,250 @@ static int imap_get_mailbox(const char *path, struct ImapData **hidata, char *bu
   return 0;
 }
 
+/* imap_sort_key: map a mutt sort method onto an RFC 5256 sort key, or
+ *   return NULL if the server can't sort exactly the way mutt would.
+ *   SIZE and SUBJECT don't qualify: mutt sorts by body length and by
+ *   $reply_regexp, the server by RFC822.SIZE and its own base subject.
+ *   Nor does any REVERSE sort: the server still breaks ties by ascending
+ *   message number, where mutt reverses that too. */
+static const char *imap_sort_key(short method)
+{
+  if (method & SORT_REVERSE)
+    return NULL;
+
+  switch (method & SORT_MASK)
+  {
+    case SORT_DATE:
+      return "DATE";
+    case SORT_RECEIVED:
+      return "ARRIVAL";
+    default:
+      return NULL;
+  }
+}
+
+/* imap_sort_headers: put ctx->hdrs in the order given by the server's SORT
+ *   extension instead of sorting locally. One UID SORT result is reused
+ *   until the mailbox contents or $sort/$sort_aux change.
+ *   Returns 0 if the headers were sorted, -1 if the caller should fall
+ *   back to sorting them itself. */
+int imap_sort_headers(struct Context *ctx)
+{
+  struct ImapData *idata = NULL;
+  struct Header **hdrs = NULL;
+  struct Header *h = NULL;
+  unsigned char *seen = NULL;
+  const char *key = NULL;
+  const char *aux = NULL;
+  char buf[SHORT_STRING];
+  int n = 0;
+  int rc;
+
+  if (!option(OPTIMAPSERVERSORT) || !ctx || !(idata = ctx->data) ||
+      (idata->ctx != ctx) || !idata->uid_hash ||
+      !mutt_bit_isset(idata->capabilities, SORT))
+    return -1;
+
+  if (!(key = imap_sort_key(Sort)))
+    return -1;
+  /* ties are broken by message number, which is what SORT_ORDER means */
+  if ((SortAux != SORT_ORDER) && (SortAux != Sort) && !(aux = imap_sort_key(SortAux)))
+    return -1;
+
+  if (!idata->sort_uids || (idata->sort_method != Sort) || (idata->sort_aux != SortAux))
+  {
+    FREE(&idata->sort_uids);
+    idata->sort_count = 0;
+
+    snprintf(buf, sizeof(buf), "UID SORT (%s%s%s) UTF-8 ALL", key,
+             aux ? " " : "", NONULL(aux));
+
+    idata->cmdtype = IMAP_CT_SORT;
+    rc = imap_exec(idata, buf, IMAP_CMD_FAIL_OK);
+    idata->cmdtype = IMAP_CT_NONE;
+    if (rc != 0)
+    {
+      mutt_debug(1, "imap_sort_headers: SORT failed, sorting locally\n");
+      if (rc == -2)
+        mutt_bit_unset(idata->capabilities, SORT);
+      FREE(&idata->sort_uids);
+      idata->sort_count = 0;
+      return -1;
+    }
+
+    idata->sort_method = Sort;
+    idata->sort_aux = SortAux;
+  }
+
+  if (idata->sort_count != ctx->msgcount)
+    return -1;
+
+  hdrs = safe_malloc(ctx->msgcount * sizeof(struct Header *));
+  seen = safe_calloc(ctx->msgcount, 1);
+  for (unsigned int i = 0; i < idata->sort_count; i++)
+  {
+    h = int_hash_find(idata->uid_hash, idata->sort_uids[i]);
+    if (!h || (h->index < 0) || (h->index >= ctx->msgcount) || seen[h->index])
+      break;
+    seen[h->index] = 1;
+    hdrs[n++] = h;
+  }
+
+  rc = -1;
+  if (n == ctx->msgcount)
+  {
+    memcpy(ctx->hdrs, hdrs, n * sizeof(struct Header *));
+    rc = 0;
+  }
+  else
+    mutt_debug(1, "imap_sort_headers: SORT result doesn't match the mailbox\n");
+
+  FREE(&hdrs);
+  FREE(&seen);
+  return rc;
+}
+
+/* imap_pool_find: return the slot'th connection of the pool used to check
+ *   mailboxes on base's account, opening another connection if the pool
+ *   is not that large yet. Slot 0 is base itself. Falls back to base if
+ *   no further connection can be had. */
+static struct ImapData *imap_pool_find(struct ImapData *base, int slot)
+{
+  struct Connection *conn = NULL;
+  struct ImapData *idata = NULL;
+  int n = 0;
+
+  if (base->poolmax)
+    slot %= base->poolmax;
+  if (slot <= 0)
+    return base;
+
+  for (conn = mutt_socket_head(); conn; conn = conn->next)
+  {
+    if (conn == base->conn || conn->account.type != MUTT_ACCT_TYPE_IMAP ||
+        !conn->data || !mutt_account_match(&base->conn->account, &conn->account))
+      continue;
+
+    idata = conn->data;
+    if (idata->state < IMAP_AUTHENTICATED || idata->state >= IMAP_SELECTED ||
+        idata->status == IMAP_FATAL)
+      continue;
+
+    if (++n == slot)
+      return idata;
+  }
+
+  if (option(OPTIMAPPASSIVE))
+    return base;
+
+  idata = imap_conn_find(&base->conn->account, MUTT_IMAP_CONN_NEWCONN);
+  if (idata && idata->state < IMAP_AUTHENTICATED)
+  {
+    /* nothing else would ever pick this connection up again */
+    conn = idata->conn;
+    imap_close_connection(idata);
+    imap_free_idata(&idata);
+    conn->data = NULL;
+    mutt_socket_free(conn);
+  }
+  if (!idata)
+  {
+    /* the server won't give us more connections than we have: stop asking */
+    base->poolmax = n + 1;
+    return base;
+  }
+
+  return idata;
+}
+
+/* imap_notify_read: read whatever NOTIFY events have arrived on
+ *   connections nobody else is reading from. Selected connections pick
+ *   theirs up in imap_check(). */
+static void imap_notify_read(void)
+{
+  struct Connection *conn = NULL;
+  struct ImapData *idata = NULL;
+  int rc;
+
+  for (conn = mutt_socket_head(); conn; conn = conn->next)
+  {
+    if (conn->account.type != MUTT_ACCT_TYPE_IMAP || !(idata = conn->data))
+      continue;
+    if (!idata->notify_mboxes || idata->state != IMAP_AUTHENTICATED ||
+        idata->nextcmd != idata->lastcmd)
+      continue;
+
+    while ((rc = mutt_socket_poll(conn)) > 0)
+    {
+      if (imap_cmd_step(idata) != IMAP_CMD_CONTINUE)
+      {
+        mutt_debug(1, "Error reading NOTIFY events\n");
+        break;
+      }
+    }
+    if (rc < 0)
+    {
+      mutt_debug(1, "Poll failed, disabling NOTIFY\n");
+      mutt_bit_unset(idata->capabilities, NOTIFY);
+      FREE(&idata->notify_mboxes);
+    }
+  }
+}
+
+/* imap_notify_set: (re)register the mailboxes in mboxes with the server,
+ *   unless that is already the registered set. Returns 0 on success. */
+static int imap_notify_set(struct ImapData *idata, struct Buffer *mboxes)
+{
+  char *cmd = NULL;
+  int rc;
+
+  if (mutt_strcmp(mboxes->data, idata->notify_mboxes) == 0)
+    return 0;
+
+  safe_asprintf(&cmd,
+                "NOTIFY SET (selected-delayed (MessageNew MessageExpunge FlagChange)) "
+                "(mailboxes (%s) (MessageNew MessageExpunge FlagChange))",
+                mboxes->data);
+  rc = imap_exec(idata, cmd, IMAP_CMD_FAIL_OK);
+  FREE(&cmd);
+
+  FREE(&idata->notify_mboxes);
+  if (rc != 0)
+  {
+    mutt_debug(1, "NOTIFY SET failed, disabling NOTIFY\n");
+    mutt_bit_unset(idata->capabilities, NOTIFY);
+    return -1;
+  }
+  idata->notify_mboxes = safe_strdup(mboxes->data);
+
+  return 0;
+}
+
 /* check for new mail in any subscribed mailboxes. Given a list of mailboxes
  * rather than called once for each so that it can batch the commands and
- * save on round trips. Returns number of mailboxes with new mail. */
+ * save on round trips. The STATUS commands are spread over up to
+ * $imap_poll_connections connections per account, and all of them are sent
+ * before any responses are read, so that the servers work in parallel.
+ * Returns number of mailboxes with new mail. */
 int imap_buffy_check(int force, int check_stats)
 {
   struct ImapData *idata = NULL;
-  struct ImapData *lastdata = NULL;
+  struct ImapData **pool = NULL;
+  struct ImapData **notify = NULL;
+  struct Buffer **notify_mboxes = NULL;
+  struct ImapStatus *status = NULL;
   struct Buffy *mailbox = NULL;
   char name[LONG_STRING];
   char command[LONG_STRING];
   char munged[LONG_STRING];
   int buffies = 0;
+  int npool = 0;
+  int nnotify = 0;
+  int checked = 0;
+  int i, rc;
+
+  if (option(OPTIMAPNOTIFY))
+    imap_notify_read();
 
   for (mailbox = Incoming; mailbox; mailbox = mailbox->next)
   {
@@ -1584,18 +1862,40 @@ int imap_buffy_check(int force, int check_stats)
       continue;
     }
 
-    if (lastdata && idata != lastdata)
+    if (option(OPTIMAPNOTIFY) && mutt_bit_isset(idata->capabilities, NOTIFY))
     {
-      /* Send commands to previous server. Sorting the buffy list
-       * may prevent some infelicitous interleavings */
-      if (imap_exec(lastdata, NULL, IMAP_CMD_FAIL_OK) == -1)
-        mutt_debug(1, "Error polling mailboxes\n");
-
-      lastdata = NULL;
+      for (i = 0; i < nnotify; i++)
+        if (notify[i] == idata)
+          break;
+      if (i == nnotify)
+      {
+        safe_realloc(&notify, (nnotify + 1) * sizeof(struct ImapData *));
+        safe_realloc(&notify_mboxes, (nnotify + 1) * sizeof(struct Buffer *));
+        notify[nnotify] = idata;
+        notify_mboxes[nnotify++] = mutt_buffer_new();
+      }
+      imap_munge_mbox_name(idata, munged, sizeof(munged), name);
+      if (notify_mboxes[i]->dptr != notify_mboxes[i]->data)
+        mutt_buffer_addch(notify_mboxes[i], ' ');
+      mutt_buffer_addstr(notify_mboxes[i], munged);
+
+      /* the server tells us when this mailbox changes */
+      if (idata->notify_mboxes && (status = imap_mboxcache_get(idata, name, 0)) &&
+          status->current)
+        continue;
     }
 
-    if (!lastdata)
-      lastdata = idata;
+    if (ImapPollConnections > 1)
+      idata = imap_pool_find(idata, checked++ % ImapPollConnections);
+
+    for (i = 0; i < npool; i++)
+      if (pool[i] == idata)
+        break;
+    if (i == npool)
+    {
+      safe_realloc(&pool, (npool + 1) * sizeof(struct ImapData *));
+      pool[npool++] = idata;
+    }
 
     imap_munge_mbox_name(idata, munged, sizeof(munged), name);
     if (check_stats)
@@ -1608,16 +1908,53 @@ int imap_buffy_check(int force, int check_stats)
     if (imap_exec(idata, command, IMAP_CMD_QUEUE) < 0)
     {
       mutt_debug(1, "Error queueing command\n");
-      return 0;
+      buffies = -1;
+      break;
     }
   }
 
-  if (lastdata && (imap_exec(lastdata, NULL, IMAP_CMD_FAIL_OK) == -1))
+  for (i = 0; i < nnotify; i++)
   {
-    mutt_debug(1, "Error polling mailboxes\n");
+    if (buffies == 0)
+      imap_notify_set(notify[i], notify_mboxes[i]);
+    mutt_buffer_free(&notify_mboxes[i]);
+  }
+  FREE(&notify);
+  FREE(&notify_mboxes);
+
+  if (buffies < 0)
+  {
+    FREE(&pool);
     return 0;
   }
 
+  /* send everything first... */
+  for (i = 0; i < npool; i++)
+  {
+    if (pool[i]->cmdbuf->dptr != pool[i]->cmdbuf->data &&
+        imap_cmd_start(pool[i], NULL) < 0)
+      mutt_debug(1, "Error polling mailboxes\n");
+  }
+
+  /* ...then collect the results */
+  mutt_allow_interrupt(1);
+  for (i = 0; i < npool; i++)
+  {
+    idata = pool[i];
+    if (idata->status == IMAP_FATAL || idata->nextcmd == idata->lastcmd)
+      continue;
+
+    do
+      rc = imap_cmd_step(idata);
+    while (rc == IMAP_CMD_CONTINUE);
+
+    if (rc != IMAP_CMD_OK && rc != IMAP_CMD_NO)
+      mutt_debug(1, "Error polling mailboxes\n");
+  }
+  mutt_allow_interrupt(0);
+
+  FREE(&pool);
+
   /* collect results */
   for (mailbox = Incoming; mailbox; mailbox = mailbox->next)
   {
@@ -1674,6 +2011,31 @@ int imap_status(char *path, int queue)
   return 0;
 }
 
+/* imap_account_idata: return the connection that keeps the mailbox status
+ *   cache for idata's account. STATUS replies and NOTIFY events may arrive
+ *   on any of the account's connections (see imap_pool_find()), so they are
+ *   all filed with the oldest one, wherever they arrive. */
+static struct ImapData *imap_account_idata(struct ImapData *idata)
+{
+  struct Connection *conn = NULL;
+  struct ImapData *owner = idata;
+
+  for (conn = mutt_socket_head(); conn; conn = conn->next)
+  {
+    if (conn->account.type != MUTT_ACCT_TYPE_IMAP || !conn->data ||
+        !mutt_account_match(&idata->conn->account, &conn->account))
+      continue;
+    if (((struct ImapData *) conn->data)->state < IMAP_AUTHENTICATED ||
+        ((struct ImapData *) conn->data)->status == IMAP_FATAL)
+      continue;
+
+    /* new connections are added at the head, so the last one is the oldest */
+    owner = conn->data;
+  }
+
+  return owner;
+}
+
 /* return cached mailbox stats or NULL if create is 0 */
 struct ImapStatus *imap_mboxcache_get(struct ImapData *idata, const char *mbox, int create)
 {
@@ -1686,6 +2048,7 @@ struct ImapStatus *imap_mboxcache_get(struct ImapData *idata, const char *mbox,
   void *uidnext = NULL;
 #endif
 
+  idata = imap_account_idata(idata);
   for (cur = idata->mboxcache; cur; cur = cur->next)
   {
     status = (struct ImapStatus *) cur->data;
@@ -1734,6 +2097,20 @@ struct ImapStatus *imap_mboxcache_get(struct ImapData *idata, const char *mbox,
   return status;
 }
 
+/* imap_mboxcache_stale: stop trusting the cached counts of idata's account
+ *   until the next STATUS */
+void imap_mboxcache_stale(struct ImapData *idata)
+{
+  struct List *cur = NULL;
+
+  for (cur = idata->mboxcache; cur; cur = cur->next)
+    ((struct ImapStatus *) cur->data)->current = false;
+
+  if (idata->conn && (idata = imap_account_idata(idata)))
+    for (cur = idata->mboxcache; cur; cur = cur->next)
+      ((struct ImapStatus *) cur->data)->current = false;
+}
+
 void imap_mboxcache_free(struct ImapData *idata)
 {
   struct List *cur = NULL;
@@ -48,6 +48,7 @@ int imap_search(struct Context *ctx, const struct Pattern *pat);
 int imap_subscribe(char *path, int subscribe);
 int imap_complete(char *dest, size_t dlen, char *path);
 int imap_fast_trash(struct Context *ctx, char *dest);
+int imap_sort_headers(struct Context *ctx);
 
 void imap_allow_reopen(struct Context *ctx);
 void imap_disallow_reopen(struct Context *ctx);
@@ -62,6 +63,7 @@ int imap_mailbox_rename(const char *mailbox);
 /* message.c */
 int imap_append_message(struct Context *ctx, struct Message *msg);
 int imap_copy_messages(struct Context *ctx, struct Header *h, char *dest, int delete);
+int imap_prefetch(void);
 
 /* socket.c */
 void imap_logout_all(void);
@@ -123,6 +123,8 @@ enum
   IDLE,          /* RFC 2177: IDLE */
   SASL_IR,       /* SASL initial response draft */
   ENABLE,        /* RFC 5161 */
+  NOTIFY,        /* RFC 5465 */
+  SORT,          /* RFC 5256 */
 
   CAPMAX
 };
@@ -130,6 +132,7 @@ enum
 /* imap_conn_find flags */
 #define MUTT_IMAP_CONN_NONEW    (1 << 0)
 #define MUTT_IMAP_CONN_NOSELECT (1 << 1)
+#define MUTT_IMAP_CONN_NEWCONN  (1 << 2)
 
 /* -- data structures -- */
 struct ImapCache
@@ -147,6 +150,8 @@ struct ImapStatus
   unsigned int uidnext;
   unsigned int uidvalidity;
   unsigned int unseen;
+
+  bool current; /* last STATUS carried UNSEEN, counts can be trusted */
 };
 
 struct ImapList
@@ -169,7 +174,8 @@ struct ImapCommand
 typedef enum {
   IMAP_CT_NONE = 0,
   IMAP_CT_LIST,
-  IMAP_CT_STATUS
+  IMAP_CT_STATUS,
+  IMAP_CT_SORT
 } IMAP_COMMAND_TYPE;
 
 struct ImapData
@@ -213,6 +219,13 @@ struct ImapData
   /* cache ImapStatus of visited mailboxes */
   struct List *mboxcache;
 
+  /* mailbox list last registered with NOTIFY, NULL if none */
+  char *notify_mboxes;
+
+  /* connections the server allowed us when opening another one failed,
+   * 0 if none has failed yet */
+  int poolmax;
+
   /* The following data is all specific to the currently SELECTED mbox */
   char delim;
   struct Context *ctx;
@@ -228,6 +241,13 @@ struct ImapData
   unsigned int msn_index_size; /* allocation size */
   unsigned int max_msn;        /* the largest MSN fetched so far */
   struct BodyCache *bcache;
+  unsigned int prefetch_uid; /* prefetch bodies following this message */
+
+  /* result of the last UID SORT, and the $sort/$sort_aux it was run for */
+  unsigned int *sort_uids;
+  unsigned int sort_count;
+  short sort_method;
+  short sort_aux;
 
   /* all folder flags - system flags AND keywords */
   struct List *flags;
@@ -243,6 +263,7 @@ int imap_check(struct ImapData *idata, int force);
 int imap_create_mailbox(struct ImapData *idata, char *mailbox);
 int imap_rename_mailbox(struct ImapData *idata, struct ImapMbox *mx, const char *newname);
 struct ImapStatus *imap_mboxcache_get(struct ImapData *idata, const char *mbox, int create);
+void imap_mboxcache_stale(struct ImapData *idata);
 void imap_mboxcache_free(struct ImapData *idata);
 int imap_exec_msgset(struct ImapData *idata, const char *pre, const char *post,
                      int flag, int changed, int invert);
@@ -250,6 +271,7 @@ int imap_open_connection(struct ImapData *idata);
 void imap_close_connection(struct ImapData *idata);
 struct ImapData *imap_conn_find(const struct Account *account, int flags);
 int imap_read_literal(FILE *fp, struct ImapData *idata, long bytes, struct Progress *pbar);
+int imap_read_literal_buf(struct Buffer *b, struct ImapData *idata, long bytes);
 void imap_expunge_mailbox(struct ImapData *idata);
 void imap_logout(struct ImapData **idata);
 int imap_sync_message(struct ImapData *idata, struct Header *hdr, struct Buffer *cmd, int *err_continue);
@@ -296,12 +296,14 @@ static int msg_parse_fetch(struct ImapHeader *h, char *s)
 }
 
 /* msg_fetch_header: import IMAP FETCH response into an ImapHeader.
- *   Expects string beginning with * n FETCH.
+ *   Expects string beginning with * n FETCH. Any header literal is
+ *   appended to hdrbuf, if given.
  *   Returns:
  *      0 on success
  *     -1 if the string is not a fetch response
  *     -2 if the string is a corrupt fetch response */
-static int msg_fetch_header(struct Context *ctx, struct ImapHeader *h, char *buf, FILE *fp)
+static int msg_fetch_header(struct Context *ctx, struct ImapHeader *h, char *buf,
+                            struct Buffer *hdrbuf)
 {
   struct ImapData *idata = NULL;
   long bytes;
@@ -332,12 +334,13 @@ static int msg_fetch_header(struct Context *ctx, struct ImapHeader *h, char *buf
   parse_rc = msg_parse_fetch(h, buf);
   if (!parse_rc)
     return 0;
-  if (parse_rc != -2 || !fp)
+  if (parse_rc != -2 || !hdrbuf)
     return rc;
 
   if (imap_get_literal_count(buf, &bytes) == 0)
   {
-    imap_read_literal(fp, idata, bytes, NULL);
+    if (imap_read_literal_buf(hdrbuf, idata, bytes) < 0)
+      return rc;
 
     /* we may have other fields of the FETCH _after_ the literal
      * (eg Domino puts FLAGS here). Nothing wrong with that, either.
@@ -463,7 +466,10 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
   struct Context *ctx = NULL;
   char *hdrreq = NULL;
   FILE *fp = NULL;
+  struct Buffer *hdrbuf = NULL;
+#ifndef USE_FMEMOPEN
   char tempfile[_POSIX_PATH_MAX];
+#endif
   int msgno, idx;
   struct ImapHeader h;
   struct ImapStatus *status = NULL;
@@ -505,7 +511,8 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
   }
 
   /* instead of downloading all headers and then parsing them, we parse them
-   * as they come in. */
+   * as they come in. Each header literal is read into memory in bulk. */
+#ifndef USE_FMEMOPEN
   mutt_mktemp(tempfile, sizeof(tempfile));
   if (!(fp = safe_fopen(tempfile, "w+")))
   {
@@ -514,6 +521,8 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
     goto error_out_0;
   }
   unlink(tempfile);
+#endif
+  hdrbuf = mutt_buffer_new();
 
   /* make sure context has room to hold the mailbox */
   while (msn_end > ctx->hdrmax)
@@ -522,6 +531,8 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
 
   idx = ctx->msgcount;
   oldmsgcount = ctx->msgcount;
+  FREE(&idata->sort_uids);
+  idata->sort_count = 0;
   idata->reopen &= ~(IMAP_REOPEN_ALLOW | IMAP_NEWMAIL_PENDING);
   idata->newMailCount = 0;
 
@@ -667,7 +678,7 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
     {
       mutt_progress_update(&progress, msgno, -1);
 
-      rewind(fp);
+      hdrbuf->dptr = hdrbuf->data;
       memset(&h, 0, sizeof(h));
       h.data = safe_calloc(1, sizeof(struct ImapHeaderData));
 
@@ -681,19 +692,16 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
         if (rc != IMAP_CMD_CONTINUE)
           break;
 
-        if ((mfhrc = msg_fetch_header(ctx, &h, idata->buf, fp)) < 0)
+        if ((mfhrc = msg_fetch_header(ctx, &h, idata->buf, hdrbuf)) < 0)
           continue;
 
-        if (!ftello(fp))
+        if (hdrbuf->dptr == hdrbuf->data)
         {
           mutt_debug(
               2, "msg_fetch_header: ignoring fetch response with no body\n");
           continue;
         }
 
-        /* make sure we don't get remnants from older larger message headers */
-        fputs("\n\n", fp);
-
         if (h.data->msn < 1 || h.data->msn > fetch_msn_end)
         {
           mutt_debug(1, "imap_read_headers: skipping FETCH response for "
@@ -711,6 +719,16 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
           continue;
         }
 
+#ifdef USE_FMEMOPEN
+        fp = fmemopen(hdrbuf->data, hdrbuf->dptr - hdrbuf->data, "r");
+        if (!fp)
+        {
+          mutt_perror(_("Error opening memstream"));
+          mfhrc = -2;
+          break;
+        }
+#endif
+
         ctx->hdrs[idx] = mutt_new_header();
 
         idata->max_msn = MAX(idata->max_msn, h.data->msn);
@@ -732,10 +750,19 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
         if (maxuid < h.data->uid)
           maxuid = h.data->uid;
 
+#ifndef USE_FMEMOPEN
         rewind(fp);
+        fwrite(hdrbuf->data, 1, hdrbuf->dptr - hdrbuf->data, fp);
+        /* make sure we don't get remnants from older larger message headers */
+        fputs("\n\n", fp);
+        rewind(fp);
+#endif
         /* NOTE: if Date: header is missing, mutt_read_rfc822_header depends
          *   on h.received being set */
         ctx->hdrs[idx]->env = mutt_read_rfc822_header(fp, ctx->hdrs[idx], 0, 0);
+#ifdef USE_FMEMOPEN
+        safe_fclose(&fp);
+#endif
         /* content built as a side-effect of mutt_read_rfc822_header */
         ctx->hdrs[idx]->content->length = h.content_length;
         ctx->size += h.content_length;
@@ -815,6 +842,7 @@ int imap_read_headers(struct ImapData *idata, unsigned int msn_begin, unsigned i
 
 error_out_1:
   safe_fclose(&fp);
+  mutt_buffer_free(&hdrbuf);
 
 error_out_0:
   FREE(&hdrreq);
@@ -980,6 +1008,8 @@ int imap_fetch_message(struct Context *ctx, struct Message *msg, int msgno)
   msg_cache_commit(idata, h);
 
 parsemsg:
+  idata->prefetch_uid = HEADER_DATA(h)->uid;
+
   /* Update the header information.  Previously, we only downloaded a
    * portion of the headers, those required for the main display.
    */
@@ -1029,6 +1059,142 @@ bail:
   return -1;
 }
 
+/* msg_prefetch: download the body of h into the body cache. The fetch is
+ *   always done with BODY.PEEK[] so the message's flags aren't touched.
+ *   Returns 0 on success, -1 on failure. */
+static int msg_prefetch(struct ImapData *idata, struct Header *h)
+{
+  char buf[SHORT_STRING];
+  char *pc = NULL;
+  long bytes;
+  FILE *fp = NULL;
+  short fetched = 0;
+  int rc;
+
+  if (!(fp = msg_cache_put(idata, h)))
+    return -1;
+
+  mutt_debug(2, "msg_prefetch: fetching UID %u\n", HEADER_DATA(h)->uid);
+
+  /* see imap_fetch_message() */
+  h->active = false;
+
+  snprintf(buf, sizeof(buf), "UID FETCH %u BODY.PEEK[]", HEADER_DATA(h)->uid);
+  imap_cmd_start(idata, buf);
+  do
+  {
+    if ((rc = imap_cmd_step(idata)) != IMAP_CMD_CONTINUE)
+      break;
+
+    pc = imap_next_word(idata->buf);
+    pc = imap_next_word(pc);
+    if (ascii_strncasecmp("FETCH", pc, 5) != 0)
+      continue;
+
+    while (*pc)
+    {
+      pc = imap_next_word(pc);
+      if (pc[0] == '(')
+        pc++;
+      if (ascii_strncasecmp("BODY[]", pc, 6) == 0)
+      {
+        pc = imap_next_word(pc);
+        if (imap_get_literal_count(pc, &bytes) < 0)
+          goto bail;
+        if (imap_read_literal(fp, idata, bytes, NULL) < 0)
+          goto bail;
+        /* pick up trailing line */
+        if ((rc = imap_cmd_step(idata)) != IMAP_CMD_CONTINUE)
+          goto bail;
+        pc = idata->buf;
+
+        fetched = 1;
+      }
+      else if ((ascii_strncasecmp("FLAGS", pc, 5) == 0) && !h->changed)
+      {
+        if ((pc = imap_set_flags(idata, h, pc)) == NULL)
+          goto bail;
+      }
+    }
+  } while (rc == IMAP_CMD_CONTINUE);
+
+  h->active = true;
+
+  if (safe_fclose(&fp) != 0 || rc != IMAP_CMD_OK || !fetched || !imap_code(idata->buf))
+    goto bail;
+
+  return msg_cache_commit(idata, h);
+
+bail:
+  h->active = true;
+  safe_fclose(&fp);
+  snprintf(buf, sizeof(buf), "%u-%u.tmp", idata->uid_validity, HEADER_DATA(h)->uid);
+  mutt_bcache_del(idata->bcache, buf);
+  return -1;
+}
+
+/* imap_prefetch: spend idle time pulling the bodies of the $imap_prefetch
+ *   messages following the last one opened, in display order, into the
+ *   body cache. Only one message is fetched per call, so that a keypress
+ *   is never held up for longer than a single body takes to arrive.
+ *   Returns 1 if a message was fetched and there may be more to do,
+ *   0 if there is nothing (left) to prefetch. */
+int imap_prefetch(void)
+{
+  struct ImapData *idata = NULL;
+  struct Header *cur = NULL;
+  struct Header *h = NULL;
+  char id[_POSIX_PATH_MAX];
+
+  if (ImapPrefetch <= 0 || !MessageCachedir || !*MessageCachedir || !Context ||
+      (Context->magic != MUTT_IMAP) || !(idata = Context->data))
+    return 0;
+
+  if (!idata->prefetch_uid || (idata->ctx != Context) ||
+      (idata->state < IMAP_SELECTED) || (idata->status == IMAP_FATAL) ||
+      !mutt_bit_isset(idata->capabilities, IMAP4REV1))
+    return 0;
+
+  /* never interleave with a command that is already in flight. An IDLE
+   * is fine: its DONE is already queued and goes out ahead of the FETCH. */
+  if ((idata->state != IMAP_IDLE) && ((idata->nextcmd != idata->lastcmd) ||
+                                      (idata->cmdbuf->dptr != idata->cmdbuf->data)))
+    return 0;
+
+  if (!idata->uid_hash ||
+      !(cur = int_hash_find(idata->uid_hash, idata->prefetch_uid)) ||
+      (cur->virtual < 0))
+  {
+    idata->prefetch_uid = 0;
+    return 0;
+  }
+
+  if (!(idata->bcache = msg_cache_open(idata)))
+    return 0;
+
+  for (int i = 1; (i <= ImapPrefetch) && (cur->virtual + i < Context->vcount); i++)
+  {
+    h = Context->hdrs[Context->v2r[cur->virtual + i]];
+    if (!h->active || h->deleted)
+      continue;
+    if ((ImapPrefetchSize > 0) && h->content &&
+        (h->content->length > ImapPrefetchSize * 1024L))
+      continue;
+
+    snprintf(id, sizeof(id), "%u-%u", idata->uid_validity, HEADER_DATA(h)->uid);
+    if (mutt_bcache_exists(idata->bcache, id) == 0)
+      continue;
+
+    if (msg_prefetch(idata, h) < 0)
+      break;
+    return 1;
+  }
+
+  /* everything ahead of the cursor is cached, or we hit an error */
+  idata->prefetch_uid = 0;
+  return 0;
+}
+
 int imap_close_message(struct Context *ctx, struct Message *msg)
 {
   return safe_fclose(&msg->fp);
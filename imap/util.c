@@ -506,6 +506,8 @@ void imap_free_idata(struct ImapData **idata)
     return;
 
   FREE(&(*idata)->capstr);
+  FREE(&(*idata)->notify_mboxes);
+  FREE(&(*idata)->sort_uids);
   mutt_free_list(&(*idata)->flags);
   imap_mboxcache_free(*idata);
   mutt_buffer_free(&(*idata)->cmdbuf);
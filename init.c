@@ -2803,6 +2803,11 @@ static int parse_set(struct Buffer *tmp, struct Buffer *s, unsigned long data,
         if (*ptr < 0)
           *ptr = 0;
       }
+      else if (mutt_strcmp(MuttVars[idx].option, "imap_poll_connections") == 0)
+      {
+        if (*ptr < 1)
+          *ptr = 1;
+      }
 #endif
     }
     else if (DTYPE(MuttVars[idx].type) == DT_QUAD)
@@ -3212,6 +3217,9 @@ int mutt_parse_rc_line(/* const */ char *line, struct Buffer *token, struct Buff
     }
   }
 finish:
+  /* any command may change the way the index or the sidebar looks */
+  IndexGeneration++;
+  SidebarGeneration++;
   if (expn.destroy)
     FREE(&expn.data);
   return r;
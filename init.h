@@ -456,6 +456,19 @@ struct Option MuttVars[] = {
   ** See the text describing the $$status_format option for more
   ** information on how to set $$compose_format.
   */
+  { "compress_builtin", DT_BOOL, R_NONE, OPTCOMPRESSBUILTIN, 1 },
+  /*
+  ** .pp
+  ** When \fIset\fP, Mutt will decompress and compress gzip, xz and zstd
+  ** compressed folders itself, instead of running the \fCopen-hook\fP,
+  ** \fCclose-hook\fP and \fCappend-hook\fP commands.  The hooks are still
+  ** needed to mark a folder as compressed and to decide whether it can be
+  ** written or appended to.  The format is recognised by the contents of the
+  ** file, or by its suffix (``.gz'', ``.xz'' or ``.zst'') if it is empty.
+  ** Formats Mutt wasn't built with support for are left to the hooks.
+  ** .pp
+  ** Appending to a folder only compresses the new messages.
+  */
   { "config_charset",   DT_STR,  R_NONE, UL &ConfigCharset, UL 0 },
   /*
   ** .pp
@@ -1386,6 +1399,16 @@ struct Option MuttVars[] = {
   ** .pp
   ** This variable defaults to the value of $$imap_user.
   */
+  { "imap_notify",              DT_BOOL, R_NONE, OPTIMAPNOTIFY, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, and the server supports the NOTIFY extension (RFC 5465),
+  ** mutt asks the server to announce new and expunged messages in all the
+  ** IMAP mailboxes on your $$mailboxes list.  Mutt then only reads these
+  ** announcements when checking for new mail, and sends a STATUS command
+  ** only for mailboxes the server has reported as changed, instead of for
+  ** every mailbox every $$mail_check seconds.
+  */
   { "imap_pass",        DT_STR,  R_NONE|F_SENSITIVE, UL &ImapPass, UL 0 },
   /*
   ** .pp
@@ -1425,6 +1448,39 @@ struct Option MuttVars[] = {
   ** .pp
   ** \fBNote:\fP Changes to this variable have no effect on open connections.
   */
+  { "imap_poll_connections",    DT_NUM,  R_NONE, UL &ImapPollConnections, 1 },
+  /*
+  ** .pp
+  ** The number of connections per IMAP account that mutt may use to check
+  ** mailboxes for new mail.  The STATUS commands for all mailboxes are
+  ** spread over these connections and sent before any replies are read,
+  ** so a server can work on several of them at once.  The extra
+  ** connections are opened on first use and then kept open, and are kept
+  ** alive along with the others (see $$imap_keepalive).
+  ** .pp
+  ** Setting this above 1 only helps with many mailboxes on one account;
+  ** servers often limit the number of connections per user.
+  ** $$imap_passive prevents the extra connections from being opened.
+  */
+  { "imap_prefetch",            DT_NUM,  R_NONE, UL &ImapPrefetch, 0 },
+  /*
+  ** .pp
+  ** When set to a value greater than zero, mutt uses the time spent waiting
+  ** for a keypress to download the bodies of up to this many messages
+  ** following the one most recently opened, in display order, into the
+  ** $$message_cachedir.  Reading on through a folder or thread then doesn't
+  ** have to wait for the server.  At most one message is fetched between
+  ** keypresses, and messages are fetched with BODY.PEEK so their flags are
+  ** left alone.  This has no effect unless $$message_cachedir is set.
+  ** .pp
+  ** See also $$imap_prefetch_size.
+  */
+  { "imap_prefetch_size",       DT_NUM,  R_NONE, UL &ImapPrefetchSize, 1024 },
+  /*
+  ** .pp
+  ** Messages larger than this many kilobytes are not fetched by
+  ** $$imap_prefetch.  Set this to 0 to prefetch messages of any size.
+  */
   { "imap_servernoise",         DT_BOOL, R_NONE, OPTIMAPSERVERNOISE, 1 },
   /*
   ** .pp
@@ -1434,6 +1490,23 @@ struct Option MuttVars[] = {
   ** server which are out of the users' hands, you may wish to suppress
   ** them at some point.
   */
+  { "imap_server_sort",         DT_BOOL, R_NONE, OPTIMAPSERVERSORT, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, and the server supports the SORT extension (RFC 5256),
+  ** mutt asks the server for the order of the messages in IMAP mailboxes
+  ** instead of sorting them itself.  This is only done when $$sort is
+  ** \fCdate\fP or \fCdate-received\fP and $$sort_aux is one of these or
+  ** \fCmailbox-order\fP, none of them reversed, since only then does the
+  ** server's order match mutt's exactly; for anything else, including
+  ** threads, mutt sorts locally as usual.  The server's answer is reused
+  ** until the mailbox changes.
+  ** .pp
+  ** Sorting by date locally is fast, and the SORT command is one more round
+  ** trip that makes the server do the same work, so this only helps when
+  ** mutt runs on a machine much slower than the server.  Otherwise leave it
+  ** unset.
+  */
   { "imap_user",        DT_STR,  R_NONE|F_SENSITIVE, UL &ImapUser, UL 0 },
   /*
   ** .pp
@@ -1776,6 +1849,19 @@ struct Option MuttVars[] = {
   ** (useful for slow links to avoid many redraws).
   */
 #if defined(USE_IMAP) || defined(USE_POP)
+  { "message_cache_backend", DT_STR,   R_NONE, UL &MessageCacheBackend, 0 },
+  /*
+  ** .pp
+  ** This variable specifies how messages are stored in $$message_cachedir.
+  ** When \fIunset\fP, every message is kept in a file of its own.  When set
+  ** to ``pack'', messages are appended to a single file per mailbox, which
+  ** copes better with mailboxes holding a very large number of messages.
+  ** Space left by removed messages is reclaimed when the mailbox is closed
+  ** once it makes up half of that file.
+  ** .pp
+  ** Messages already cached remain readable after changing this variable.
+  ** It can be set per account with an \fC$<account-hook>\fP.
+  */
   { "message_cache_clean", DT_BOOL, R_NONE, OPTMESSAGECACHECLEAN, 0 },
   /*
   ** .pp
@@ -1784,6 +1870,18 @@ struct Option MuttVars[] = {
   ** every once in a while, since it can be a little slow
   ** (especially for large folders).
   */
+  { "message_cache_size", DT_NUM,      R_NONE, UL &MessageCacheSize, 0 },
+  /*
+  ** .pp
+  ** The largest size in megabytes the message cache of a single mailbox
+  ** may grow to.  When storing a message pushes the cache past this
+  ** limit, the messages read least recently are removed until it fits
+  ** again.  A value of 0 means the cache is not limited.
+  ** .pp
+  ** Identical messages cached for several mailboxes, for example copies
+  ** of the same message in different IMAP folders, are stored only once
+  ** below $$message_cachedir.
+  */
   { "message_cachedir", DT_PATH,        R_NONE, UL &MessageCachedir, 0 },
   /*
   ** .pp
@@ -1795,7 +1893,7 @@ struct Option MuttVars[] = {
   ** remote message only once and can perform regular expression searches
   ** as fast as for local folders.
   ** .pp
-  ** Also see the $$message_cache_clean variable.
+  ** Also see the $$message_cache_clean and $$message_cache_size variables.
   */
 #endif
   { "message_format",   DT_STR,  R_NONE, UL &MsgFmt, UL "%s" },
@@ -469,6 +469,18 @@ int km_dokey(int menu)
   {
     i = Timeout > 0 ? Timeout : 60;
 #ifdef USE_IMAP
+    /* while no key is waiting, use the time to prefetch message bodies */
+    while (ImapPrefetch > 0)
+    {
+      timeout(0);
+      tmp = mutt_getch();
+      timeout(-1);
+      if (tmp.ch != -2 || SigWinch)
+        goto gotkey;
+      if (!imap_prefetch())
+        break;
+    }
+
     /* keepalive may need to run more frequently than Timeout allows */
     if (ImapKeepalive)
     {
@@ -829,7 +829,7 @@ int main(int argc, char **argv, char **env)
   {
     if (flags & MUTT_BUFFY)
     {
-      if (!mutt_buffy_check(0))
+      if (!mutt_buffy_check(1))
       {
         mutt_endwin(_("No mailbox with new mail."));
         exit(1);
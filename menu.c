@@ -21,6 +21,7 @@
 #include <regex.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include "mutt.h"
@@ -89,6 +90,50 @@ static int get_color(int index, unsigned char *s)
   return 0;
 }
 
+/**
+ * menu_row_volatile - Does an entry's colour depend on more than its text?
+ * @s: Entry, as returned by make_entry()
+ *
+ * The author, flags and subject of an index entry may be coloured by patterns
+ * matching the header.  These have to be redrawn every time.
+ */
+static bool menu_row_volatile(const char *s)
+{
+  if (!ColorIndexAuthorList && !ColorIndexFlagsList && !ColorIndexSubjectList
+#ifdef USE_NOTMUCH
+      && !ColorIndexTagList
+#endif
+      )
+    return false;
+
+  for (; (s = strchr(s, MUTT_SPECIAL_INDEX)) && s[1]; s += 2)
+  {
+    switch (s[1])
+    {
+      case MT_COLOR_INDEX_AUTHOR:
+        if (ColorIndexAuthorList)
+          return true;
+        break;
+      case MT_COLOR_INDEX_FLAGS:
+        if (ColorIndexFlagsList)
+          return true;
+        break;
+      case MT_COLOR_INDEX_SUBJECT:
+        if (ColorIndexSubjectList)
+          return true;
+        break;
+#ifdef USE_NOTMUCH
+      case MT_COLOR_INDEX_TAG:
+        if (ColorIndexTagList)
+          return true;
+        break;
+#endif
+    }
+  }
+
+  return false;
+}
+
 static void print_enriched_string(int index, int attr, unsigned char *s, int do_color)
 {
   wchar_t wc;
@@ -278,6 +323,117 @@ static void menu_pad_string(struct Menu *menu, char *s, size_t n)
   FREE(&scratch);
 }
 
+/**
+ * menu_damage_all - Mark every row of a Menu as needing a redraw
+ * @menu: Menu
+ *
+ * This must be called when something else has drawn over the menu, e.g. the
+ * screen has been cleared.
+ */
+void menu_damage_all(struct Menu *menu)
+{
+  for (int i = 0; i < menu->rowcount; i++)
+    FREE(&menu->rows[i].text);
+  FREE(&menu->rows);
+  menu->rowcount = 0;
+}
+
+/**
+ * menu_damage_row - Mark the row of an entry as needing a redraw
+ * @menu: Menu
+ * @i:    Entry
+ */
+static void menu_damage_row(struct Menu *menu, int i)
+{
+  int row = i - menu->top;
+
+  if ((row >= 0) && (row < menu->rowcount))
+  {
+    FREE(&menu->rows[row].text);
+    menu->rows[row].entry = -1;
+  }
+}
+
+/**
+ * menu_check_rows - Make sure the Menu's rows match its window
+ * @menu: Menu
+ *
+ * If the menu has moved, or changed size, all its rows are damaged.
+ */
+static void menu_check_rows(struct Menu *menu)
+{
+  int line = menu->indexwin->row_offset + menu->offset;
+
+  if ((menu->rowcount == menu->pagelen) && (menu->rowline == line) &&
+      (menu->rowcol == menu->indexwin->col_offset) &&
+      (menu->rowwidth == menu->indexwin->cols))
+    return;
+
+  menu_damage_all(menu);
+  if (menu->pagelen <= 0)
+    return;
+
+  menu->rows = safe_calloc(menu->pagelen, sizeof(struct MenuRow));
+  for (int i = 0; i < menu->pagelen; i++)
+    menu->rows[i].entry = -1;
+  menu->rowcount = menu->pagelen;
+  menu->rowtop = menu->top;
+  menu->rowline = line;
+  menu->rowcol = menu->indexwin->col_offset;
+  menu->rowwidth = menu->indexwin->cols;
+}
+
+/**
+ * menu_scroll_rows - Move the Menu's rows to match its top entry
+ * @menu: Menu
+ *
+ * If the menu is as wide as the screen, i.e. the sidebar isn't visible, the
+ * rows that are still on the page can be scrolled by the terminal.  Then only
+ * the rows that have scrolled into view need to be drawn.
+ */
+static void menu_scroll_rows(struct Menu *menu)
+{
+  struct MenuRow *rows = menu->rows;
+  int count = menu->rowcount;
+  int n = menu->top - menu->rowtop;
+
+  menu->rowtop = menu->top;
+  if ((n == 0) || (abs(n) >= count) || (menu->rowcol != 0) || (menu->rowwidth != COLS))
+    return;
+
+#ifndef USE_SLANG_CURSES
+  if (n > 0)
+  {
+    for (int i = 0; i < n; i++)
+      FREE(&rows[i].text);
+    memmove(rows, rows + n, (count - n) * sizeof(struct MenuRow));
+    for (int i = count - n; i < count; i++)
+    {
+      rows[i].text = NULL;
+      rows[i].entry = -1;
+    }
+  }
+  else
+  {
+    for (int i = count + n; i < count; i++)
+      FREE(&rows[i].text);
+    memmove(rows - n, rows, (count + n) * sizeof(struct MenuRow));
+    for (int i = 0; i < -n; i++)
+    {
+      rows[i].text = NULL;
+      rows[i].entry = -1;
+    }
+  }
+
+  NORMAL_COLOR;
+  setscrreg(menu->rowline, menu->rowline + count - 1);
+  scrollok(stdscr, true);
+  scrl(n);
+  scrollok(stdscr, false);
+  setscrreg(0, LINES - 1);
+#endif
+}
+
 void menu_redraw_full(struct Menu *menu)
 {
 #if !(defined(USE_SLANG_CURSES) || defined(HAVE_RESIZETERM))
@@ -287,6 +443,7 @@ void menu_redraw_full(struct Menu *menu)
   /* clear() doesn't optimize screen redraws */
   move(0, 0);
   clrtobot();
+  menu_damage_all(menu);
 
   if (option(OPTHELP))
   {
@@ -331,9 +488,15 @@ void menu_redraw_index(struct Menu *menu)
   char buf[LONG_STRING];
   int do_color;
   int attr;
+  struct MenuRow *row = NULL;
+
+  menu_check_rows(menu);
+  menu_scroll_rows(menu);
 
   for (int i = menu->top; i < menu->top + menu->pagelen; i++)
   {
+    row = &menu->rows[i - menu->top];
+
     if (i < menu->max)
     {
       attr = menu->color(i);
@@ -341,6 +504,17 @@ void menu_redraw_index(struct Menu *menu)
       menu_make_entry(buf, sizeof(buf), menu, i);
       menu_pad_string(menu, buf, sizeof(buf));
 
+      /* skip the rows that are already on the screen */
+      if ((row->entry == i) && (row->attr == attr) &&
+          (row->current == (i == menu->current)) &&
+          (mutt_strcmp(row->text, buf) == 0) && !menu_row_volatile(buf))
+        continue;
+
+      mutt_str_replace(&row->text, buf);
+      row->entry = i;
+      row->attr = attr;
+      row->current = (i == menu->current);
+
       ATTRSET(attr);
       mutt_window_move(menu->indexwin, i - menu->top + menu->offset, 0);
       do_color = 1;
@@ -364,6 +538,14 @@ void menu_redraw_index(struct Menu *menu)
     }
     else
     {
+      if ((row->entry == i) && !row->text)
+        continue;
+
+      FREE(&row->text);
+      row->entry = i;
+      row->attr = 0;
+      row->current = false;
+
       NORMAL_COLOR;
       mutt_window_clearline(menu->indexwin, i - menu->top + menu->offset);
     }
@@ -382,6 +564,9 @@ void menu_redraw_motion(struct Menu *menu)
     return;
   }
 
+  menu_damage_row(menu, menu->oldcurrent);
+  menu_damage_row(menu, menu->current);
+
   mutt_window_move(menu->indexwin, menu->oldcurrent + menu->offset - menu->top, 0);
   ATTRSET(menu->color(menu->oldcurrent));
 
@@ -428,6 +613,7 @@ void menu_redraw_current(struct Menu *menu)
   char buf[LONG_STRING];
   int attr = menu->color(menu->current);
 
+  menu_damage_row(menu, menu->current);
   mutt_window_move(menu->indexwin, menu->current + menu->offset - menu->top, 0);
   menu_make_entry(buf, sizeof(buf), menu, menu->current);
   menu_pad_string(menu, buf, sizeof(buf));
@@ -810,6 +996,7 @@ void mutt_menu_destroy(struct Menu **p)
     FREE(&(*p)->dialog);
   }
 
+  menu_damage_all(*p);
   FREE(p);
 }
 
@@ -191,6 +191,10 @@ struct ColorLine
   char *pattern;
   struct Pattern *color_pattern; /* compiled pattern to speed up index color
                                       calculation */
+  bool static_pattern;           /* color_pattern's result can be cached,
+                                    see mutt_pattern_is_static() */
+  bool uses_context;             /* rx looks at the text before a match,
+                                    e.g. \<, see resolve_chunks() */
   short fg;
   short bg;
   int pair;
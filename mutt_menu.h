@@ -40,6 +40,19 @@
 
 #define MUTT_MODEFMT "-- Mutt: %s"
 
+/**
+ * struct MenuRow - A row of a Menu, as it was last drawn
+ *
+ * menu_redraw_index() uses these to skip the rows that haven't changed.
+ */
+struct MenuRow
+{
+  char *text;   /* padded entry, NULL for an empty row */
+  int entry;    /* entry drawn on the row, -1 if the row is damaged */
+  int attr;     /* colour of the entry */
+  bool current; /* drawn with the indicator */
+};
+
 struct Menu
 {
   char *title; /* the title of this menu */
@@ -89,6 +102,14 @@ struct Menu
   int oldcurrent; /* for driver use only. */
   int searchDir;  /* direction of search */
   int tagged;     /* number of tagged entries */
+
+  /* the following are used only by menu_redraw_index() */
+  struct MenuRow *rows; /* one per row of the page */
+  int rowcount;         /* number of rows, 0 if they're all damaged */
+  int rowtop;           /* value of top when the rows were drawn */
+  int rowline;          /* screen line of the first row */
+  int rowcol;           /* screen column of the rows */
+  int rowwidth;         /* width of the rows */
 };
 
 void mutt_menu_init(void);
@@ -97,6 +118,7 @@ void menu_redraw_full(struct Menu *menu);
 void menu_redraw_sidebar(struct Menu *menu);
 #endif
 void menu_redraw_index(struct Menu *menu);
+void menu_damage_all(struct Menu *menu);
 void menu_redraw_status(struct Menu *menu);
 void menu_redraw_motion(struct Menu *menu);
 void menu_redraw_current(struct Menu *menu);
@@ -42,8 +42,10 @@
 #include <notmuch.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include "mutt.h"
@@ -57,11 +59,15 @@
 #include "header.h"
 #include "lib.h"
 #include "mailbox.h"
+#include "md5.h"
 #include "mutt_curses.h"
 #include "mx.h"
 #include "protos.h"
 #include "thread.h"
 #include "url.h"
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 
 #ifdef LIBNOTMUCH_CHECK_VERSION
 #undef LIBNOTMUCH_CHECK_VERSION
@@ -153,6 +159,9 @@ struct NmCtxdata
   struct Progress progress; /**< A progress bar */
   int oldmsgcount;
   int ignmsgcount; /**< Ignored messages */
+#ifdef USE_HCACHE
+  header_cache_t *hc; /**< Parsed messages, while reading a query */
+#endif
 
   bool noprogress : 1;     /**< Don't show the progress bar */
   bool longrun : 1;        /**< A long-lived action is in progress */
@@ -842,52 +851,46 @@ static void append_str_item(char **str, const char *item, int sep)
   memcpy(p, item, sz + 1);
 }
 
-static int update_header_tags(struct Header *h, notmuch_message_t *msg)
+static void add_header_tag(const char *t, struct NmHdrtag **tag_list, char **tstr, char **ttstr)
 {
-  struct NmHdrdata *data = h->data;
-  notmuch_tags_t *tags = NULL;
-  char *tstr = NULL, *ttstr = NULL;
-  struct NmHdrtag *tag_list = NULL, *tmp = NULL;
-
-  mutt_debug(2, "nm: tags update requested (%s)\n", data->virtual_id);
+  const char *tt = NULL;
+  struct NmHdrtag *tmp = NULL;
 
-  for (tags = notmuch_message_get_tags(msg); tags && notmuch_tags_valid(tags);
-       notmuch_tags_move_to_next(tags))
-  {
-    const char *t = notmuch_tags_get(tags);
-    const char *tt = NULL;
+  if (!t || !*t)
+    return;
 
-    if (!t || !*t)
-      continue;
+  tt = hash_find(TagTransforms, t);
+  if (!tt)
+    tt = t;
 
-    tt = hash_find(TagTransforms, t);
-    if (!tt)
-      tt = t;
+  /* tags list contains all tags */
+  tmp = safe_calloc(1, sizeof(*tmp));
+  tmp->tag = safe_strdup(t);
+  tmp->transformed = safe_strdup(tt);
+  tmp->next = *tag_list;
+  *tag_list = tmp;
 
-    /* tags list contains all tags */
-    tmp = safe_calloc(1, sizeof(*tmp));
-    tmp->tag = safe_strdup(t);
-    tmp->transformed = safe_strdup(tt);
-    tmp->next = tag_list;
-    tag_list = tmp;
+  /* filter out hidden tags */
+  if (NotmuchHiddenTags)
+  {
+    char *p = strstr(NotmuchHiddenTags, t);
+    size_t xsz = p ? strlen(t) : 0;
 
-    /* filter out hidden tags */
-    if (NotmuchHiddenTags)
-    {
-      char *p = strstr(NotmuchHiddenTags, t);
-      size_t xsz = p ? strlen(t) : 0;
+    if (p && ((p == NotmuchHiddenTags) || (*(p - 1) == ',') || (*(p - 1) == ' ')) &&
+        ((*(p + xsz) == '\0') || (*(p + xsz) == ',') || (*(p + xsz) == ' ')))
+      return;
+  }
 
-      if (p && ((p == NotmuchHiddenTags) || (*(p - 1) == ',') || (*(p - 1) == ' ')) &&
-          ((*(p + xsz) == '\0') || (*(p + xsz) == ',') || (*(p + xsz) == ' ')))
-        continue;
-    }
+  /* expand the transformed tag string */
+  append_str_item(ttstr, tt, ' ');
 
-    /* expand the transformed tag string */
-    append_str_item(&ttstr, tt, ' ');
+  /* expand the un-transformed tag string */
+  append_str_item(tstr, t, ' ');
+}
 
-    /* expand the un-transformed tag string */
-    append_str_item(&tstr, t, ' ');
-  }
+static int set_header_tags(struct Header *h, struct NmHdrtag *tag_list, char *tstr, char *ttstr)
+{
+  struct NmHdrdata *data = h->data;
 
   free_tag_list(&data->tag_list);
   data->tag_list = tag_list;
@@ -910,10 +913,26 @@ static int update_header_tags(struct Header *h, notmuch_message_t *msg)
 
   data->tags_transformed = ttstr;
   mutt_debug(2, "nm: new tag transforms: '%s'\n", ttstr);
+  FREE(&h->index_line);
 
   return 0;
 }
 
+static int update_header_tags(struct Header *h, notmuch_message_t *msg)
+{
+  notmuch_tags_t *tags = NULL;
+  char *tstr = NULL, *ttstr = NULL;
+  struct NmHdrtag *tag_list = NULL;
+
+  mutt_debug(2, "nm: tags update requested (%s)\n", header_get_id(h));
+
+  for (tags = notmuch_message_get_tags(msg); tags && notmuch_tags_valid(tags);
+       notmuch_tags_move_to_next(tags))
+    add_header_tag(notmuch_tags_get(tags), &tag_list, &tstr, &ttstr);
+
+  return set_header_tags(h, tag_list, tstr, ttstr);
+}
+
 static int update_message_path(struct Header *h, const char *path)
 {
   struct NmHdrdata *data = h->data;
@@ -987,15 +1006,8 @@ static char *nm2mutt_message_id(const char *id)
   return mid;
 }
 
-static int init_header(struct Header *h, const char *path, notmuch_message_t *msg)
+static int init_header_data(struct Header *h, const char *path, const char *id)
 {
-  const char *id = NULL;
-
-  if (h->data)
-    return 0;
-
-  id = notmuch_message_get_message_id(msg);
-
   h->data = safe_calloc(1, sizeof(struct NmHdrdata));
   h->free_cb = deinit_header;
 
@@ -1014,6 +1026,17 @@ static int init_header(struct Header *h, const char *path, notmuch_message_t *ms
   if (update_message_path(h, path))
     return -1;
 
+  return 0;
+}
+
+static int init_header(struct Header *h, const char *path, notmuch_message_t *msg)
+{
+  if (h->data)
+    return 0;
+
+  if (init_header_data(h, path, notmuch_message_get_message_id(msg)))
+    return -1;
+
   update_header_tags(h, msg);
 
   return 0;
@@ -1033,6 +1056,144 @@ static const char *get_message_last_filename(notmuch_message_t *msg)
   return name;
 }
 
+#ifdef USE_HCACHE
+/**
+ * hcache_open - Open the header cache of a notmuch database
+ *
+ * One cache is shared by all the queries of a database.  It is kept apart
+ * from the cache of a maildir at the same location by its folder name.
+ */
+static header_cache_t *hcache_open(struct NmCtxdata *data)
+{
+  char folder[_POSIX_PATH_MAX];
+  const char *db_filename = get_db_filename(data);
+
+  if (!db_filename)
+    return NULL;
+
+  snprintf(folder, sizeof(folder), "notmuch://%s", db_filename);
+  return mutt_hcache_open(HeaderCache, folder, NULL);
+}
+
+/**
+ * cache_key_finish - Finish a header cache key made of an md5 digest
+ * @param buf   Buffer for the key
+ * @param bufsz Size of the buffer
+ * @param ctx   md5 of the key's contents
+ * @param pfx   Prefix of the key
+ * @retval num Length of the key, 0 if it doesn't fit
+ *
+ * Message paths and queries can be longer than the header cache allows for
+ * a key, so only their digest is used.
+ */
+static size_t cache_key_finish(char *buf, size_t bufsz, struct Md5Ctx *ctx, const char *pfx)
+{
+  unsigned char md5[16];
+  size_t n = mutt_strlen(pfx);
+
+  if (n + 2 * sizeof(md5) >= bufsz)
+    return 0;
+
+  md5_finish_ctx(ctx, md5);
+  strfcpy(buf, pfx, bufsz);
+  for (int i = 0; i < sizeof(md5); i++)
+    sprintf(buf + n + 2 * i, "%02x", md5[i]);
+
+  return n + 2 * sizeof(md5);
+}
+
+/**
+ * hcache_key - Make the header cache key of a message file
+ *
+ * The key is the message-id and the path without the maildir flags, so that
+ * changing the flags doesn't invalidate the cached header.
+ */
+static size_t hcache_key(char *buf, size_t bufsz, const char *id, const char *path)
+{
+  const char *p = strrchr(path, '/');
+  const char *flags = strrchr(p ? p : path, ':');
+  struct Md5Ctx ctx;
+
+  md5_init_ctx(&ctx);
+  md5_process_bytes(id, strlen(id) + 1, &ctx);
+  md5_process_bytes(path, flags ? (size_t)(flags - path) : strlen(path), &ctx);
+
+  return cache_key_finish(buf, bufsz, &ctx, "msg/");
+}
+
+static struct Header *hcache_get_header(header_cache_t *hc, const char *id, const char *path)
+{
+  char key[_POSIX_PATH_MAX];
+  size_t keylen;
+  void *hdata = NULL;
+  struct stat st;
+  struct Header *h = NULL;
+
+  keylen = hcache_key(key, sizeof(key), id, path);
+  if (!hc || !keylen)
+    return NULL;
+
+  hdata = mutt_hcache_fetch(hc, key, keylen);
+  if (!hdata)
+    return NULL;
+
+  if (!option(OPTHCACHEVERIFY) ||
+      ((stat(path, &st) == 0) && (st.st_mtime <= ((struct timeval *) hdata)->tv_sec)))
+  {
+    h = mutt_hcache_restore(hdata);
+    maildir_parse_flags(h, path);
+  }
+  mutt_hcache_free(hc, &hdata);
+  return h;
+}
+#endif
+
+/**
+ * parse_message - Get the header of a message file
+ *
+ * The header cache is tried first, the file is only parsed (and the result
+ * cached) if it's not there.
+ */
+static struct Header *parse_message(struct NmCtxdata *data, const char *id, const char *path)
+{
+  struct Header *h = NULL;
+#ifdef USE_HCACHE
+  char key[_POSIX_PATH_MAX];
+  size_t keylen;
+
+  h = hcache_get_header(data->hc, id, path);
+  if (h)
+    return h;
+#endif
+
+  h = maildir_parse_message(MUTT_MAILDIR, path, 0, NULL);
+
+#ifdef USE_HCACHE
+  keylen = hcache_key(key, sizeof(key), id, path);
+  if (h && data->hc && keylen)
+    mutt_hcache_store(data->hc, key, keylen, h, 0);
+#endif
+  return h;
+}
+
+/**
+ * add_header - Add a fully initialised header to the context
+ */
+static void add_header(struct Context *ctx, struct Header *h)
+{
+  if (ctx->msgcount >= ctx->hdrmax)
+  {
+    mutt_debug(2, "nm: allocate mx memory\n");
+    mx_alloc_memory(ctx);
+  }
+
+  h->active = true;
+  h->index = ctx->msgcount;
+  ctx->size += h->content->length + h->content->offset - h->content->hdr_offset;
+  ctx->hdrs[ctx->msgcount] = h;
+  ctx->msgcount++;
+}
+
 static void progress_reset(struct Context *ctx)
 {
   struct NmCtxdata *data = NULL;
@@ -1138,13 +1299,8 @@ static void append_message(struct Context *ctx, notmuch_query_t *q,
   mutt_debug(2, "nm: appending message, i=%d, id=%s, path=%s\n", ctx->msgcount,
              notmuch_message_get_message_id(msg), path);
 
-  if (ctx->msgcount >= ctx->hdrmax)
-  {
-    mutt_debug(2, "nm: allocate mx memory\n");
-    mx_alloc_memory(ctx);
-  }
   if (access(path, F_OK) == 0)
-    h = maildir_parse_message(MUTT_MAILDIR, path, 0, NULL);
+    h = parse_message(data, notmuch_message_get_message_id(msg), path);
   else
   {
     /* maybe moved try find it... */
@@ -1176,11 +1332,7 @@ static void append_message(struct Context *ctx, notmuch_query_t *q,
     goto done;
   }
 
-  h->active = true;
-  h->index = ctx->msgcount;
-  ctx->size += h->content->length + h->content->offset - h->content->hdr_offset;
-  ctx->hdrs[ctx->msgcount] = h;
-  ctx->msgcount++;
+  add_header(ctx, h);
 
   if (newpath)
   {
@@ -1305,7 +1457,7 @@ static notmuch_message_t *get_nm_message(notmuch_database_t *db, struct Header *
   return msg;
 }
 
-static bool nm_message_has_tag(notmuch_message_t *msg, char *tag)
+static bool nm_message_has_tag(notmuch_message_t *msg, const char *tag)
 {
   const char *possible_match_tag = NULL;
   notmuch_tags_t *tags = NULL;
@@ -1322,15 +1474,18 @@ static bool nm_message_has_tag(notmuch_message_t *msg, char *tag)
   return false;
 }
 
-static int update_tags(notmuch_message_t *msg, const char *tags)
+/**
+ * split_tags - Split a list of tag changes, e.g. "+inbox -unread !flagged"
+ * @param buf List of tag changes, modified in place
+ * @retval ptr NULL-terminated array of changes, pointing into buf
+ */
+static char **split_tags(char *buf)
 {
   char *tag = NULL, *end = NULL, *p = NULL;
-  char *buf = safe_strdup(tags);
-
-  if (!buf)
-    return -1;
+  char **tags = NULL;
+  size_t count = 0;
 
-  notmuch_message_freeze(msg);
+  tags = safe_calloc(strlen(buf) / 2 + 2, sizeof(char *));
 
   for (p = buf; p && *p; p++)
   {
@@ -1348,33 +1503,94 @@ static int update_tags(notmuch_message_t *msg, const char *tags)
       break;
 
     *end = '\0';
+    tags[count++] = tag;
+    end = tag = NULL;
+  }
 
-    if (*tag == '-')
+  tags[count] = NULL;
+  return tags;
+}
+
+/**
+ * apply_tags - Apply tag changes to a message
+ * @retval n Number of tags actually added or removed
+ *
+ * The message is only written if one of its tags has to change.
+ */
+static int apply_tags(notmuch_message_t *msg, char **tags)
+{
+  int changed = 0;
+
+  for (int apply = 0; apply < 2; apply++)
+  {
+    if (apply)
     {
-      mutt_debug(1, "nm: remove tag: '%s'\n", tag + 1);
-      notmuch_message_remove_tag(msg, tag + 1);
+      if (!changed)
+        return 0;
+      notmuch_message_freeze(msg);
     }
-    else if (*tag == '!')
+
+    for (char **t = tags; *t; t++)
     {
-      mutt_debug(1, "nm: toggle tag: '%s'\n", tag + 1);
-      if (nm_message_has_tag(msg, tag + 1))
+      const char *tag = *t;
+
+      if (*tag == '-')
+      {
+        if (!nm_message_has_tag(msg, tag + 1))
+          continue;
+        if (!apply)
+          changed++;
+        else
+        {
+          mutt_debug(1, "nm: remove tag: '%s'\n", tag + 1);
+          notmuch_message_remove_tag(msg, tag + 1);
+        }
+      }
+      else if (*tag == '!')
       {
-        notmuch_message_remove_tag(msg, tag + 1);
+        if (!apply)
+          changed++;
+        else
+        {
+          mutt_debug(1, "nm: toggle tag: '%s'\n", tag + 1);
+          if (nm_message_has_tag(msg, tag + 1))
+            notmuch_message_remove_tag(msg, tag + 1);
+          else
+            notmuch_message_add_tag(msg, tag + 1);
+        }
       }
       else
       {
-        notmuch_message_add_tag(msg, tag + 1);
+        if (*tag == '+')
+          tag++;
+        if (nm_message_has_tag(msg, tag))
+          continue;
+        if (!apply)
+          changed++;
+        else
+        {
+          mutt_debug(1, "nm: add tag: '%s'\n", tag);
+          notmuch_message_add_tag(msg, tag);
+        }
       }
     }
-    else
-    {
-      mutt_debug(1, "nm: add tag: '%s'\n", (*tag == '+') ? tag + 1 : tag);
-      notmuch_message_add_tag(msg, (*tag == '+') ? tag + 1 : tag);
-    }
-    end = tag = NULL;
   }
 
   notmuch_message_thaw(msg);
+  return changed;
+}
+
+static int update_tags(notmuch_message_t *msg, const char *tags)
+{
+  char *buf = safe_strdup(tags);
+  char **list = NULL;
+
+  if (!buf)
+    return -1;
+
+  list = split_tags(buf);
+  apply_tags(msg, list);
+  FREE(&list);
   FREE(&buf);
   return 0;
 }
@@ -1868,37 +2084,92 @@ void nm_query_window_backward(void)
   mutt_debug(2, "nm_query_window_backward (%d)\n", NotmuchQueryWindowCurrentPosition);
 }
 
-int nm_modify_message_tags(struct Context *ctx, struct Header *hdr, char *buf)
+/**
+ * nm_modify_messages_tags - Add, remove or toggle tags of several messages
+ * @param ctx   Context
+ * @param hdrs  Messages to modify
+ * @param count Number of messages
+ * @param buf   Tag changes, e.g. "+inbox -unread"
+ * @retval 0 Success
+ * @retval -1 The database or one of the messages couldn't be opened
+ *
+ * All the changes are made in a single atomic transaction and messages
+ * that already have the requested tags aren't written at all.
+ */
+int nm_modify_messages_tags(struct Context *ctx, struct Header **hdrs, int count, char *buf)
 {
   struct NmCtxdata *data = get_ctxdata(ctx);
   notmuch_database_t *db = NULL;
-  notmuch_message_t *msg = NULL;
-  int rc = -1;
+  struct Progress progress;
+  struct timeval start, stop;
+  char *tagbuf = NULL;
+  char **tags = NULL;
+  int trans, changed = 0, rc = 0;
 
-  if (!buf || !*buf || !data)
+  if (!buf || !*buf || !data || (count < 1))
     return -1;
 
-  if (!(db = get_db(data, true)) || !(msg = get_nm_message(db, hdr)))
-    goto done;
+  if (!(db = get_db(data, true)) || ((trans = db_trans_begin(data)) < 0))
+  {
+    if (!is_longrun(data))
+      release_db(data);
+    return -1;
+  }
 
-  mutt_debug(1, "nm: tags modify: '%s'\n", buf);
+  mutt_debug(1, "nm: tags modify: '%s' (%d messages)\n", buf, count);
+  gettimeofday(&start, NULL);
 
-  update_tags(msg, buf);
-  update_header_flags(ctx, hdr, buf);
-  update_header_tags(hdr, msg);
-  mutt_set_header_color(ctx, hdr);
+  if (!ctx->quiet && (count > 1))
+    mutt_progress_init(&progress, _("Update labels..."), MUTT_PROGRESS_MSG, WriteInc, count);
 
-  rc = 0;
-  hdr->changed = true;
-done:
+  tagbuf = safe_strdup(buf);
+  tags = split_tags(tagbuf);
+
+  for (int i = 0; i < count; i++)
+  {
+    struct Header *hdr = hdrs[i];
+    notmuch_message_t *msg = get_nm_message(db, hdr);
+
+    if (!ctx->quiet && (count > 1))
+      mutt_progress_update(&progress, i + 1, -1);
+
+    if (!msg)
+    {
+      rc = -1;
+      continue;
+    }
+
+    if (apply_tags(msg, tags) > 0)
+      changed++;
+    update_header_flags(ctx, hdr, buf);
+    update_header_tags(hdr, msg);
+    mutt_set_header_color(ctx, hdr);
+    hdr->changed = true;
+    notmuch_message_destroy(msg);
+  }
+
+  if (trans)
+    db_trans_end(data);
   if (!is_longrun(data))
     release_db(data);
-  if (hdr->changed)
+  if (changed)
     ctx->mtime = time(NULL);
-  mutt_debug(1, "nm: tags modify done [rc=%d]\n", rc);
+
+  gettimeofday(&stop, NULL);
+  mutt_debug(1, "nm: tags modify done [rc=%d, %d of %d messages changed in %ld ms]\n",
+             rc, changed, count,
+             (long) ((stop.tv_sec - start.tv_sec) * 1000 + (stop.tv_usec - start.tv_usec) / 1000));
+
+  FREE(&tags);
+  FREE(&tagbuf);
   return rc;
 }
 
+int nm_modify_message_tags(struct Context *ctx, struct Header *hdr, char *buf)
+{
+  return nm_modify_messages_tags(ctx, &hdr, 1, buf);
+}
+
 int nm_update_filename(struct Context *ctx, const char *old, const char *new,
                        struct Header *h)
 {
@@ -1923,11 +2194,93 @@ int nm_update_filename(struct Context *ctx, const char *old, const char *new,
   return rc;
 }
 
+/**
+ * struct NmCount - Cached counts of a virtual folder
+ */
+struct NmCount
+{
+  unsigned long version; /**< Database version the counts belong to */
+  int all;
+  int new;
+};
+
+/**
+ * CountDb - Read-only database handle kept between calls of
+ * nm_nonctx_get_count(), with the counts of the queries made with it.
+ */
+static struct
+{
+  char *filename;
+  notmuch_database_t *db;
+  time_t mtime;          /**< Mtime of the database when it was opened */
+  unsigned long version; /**< Revision, or mtime if there's no revision */
+  struct Hash *counts;   /**< Query -> struct NmCount */
+} CountDb;
+
+static void count_db_close(void)
+{
+  if (CountDb.db)
+  {
+#ifdef NOTMUCH_API_3
+    notmuch_database_destroy(CountDb.db);
+#else
+    notmuch_database_close(CountDb.db);
+#endif
+    mutt_debug(1, "nm: count close DB\n");
+  }
+  CountDb.db = NULL;
+}
+
+/**
+ * count_db_open - Get a read-only handle to the database
+ *
+ * The handle is only reopened when the database has been modified, which is
+ * also the only case where the cached counts may be stale.
+ */
+static notmuch_database_t *count_db_open(const char *filename)
+{
+  struct NmCtxdata data;
+  time_t mtime = 0;
+
+  if (mutt_strcmp(filename, CountDb.filename) != 0)
+  {
+    count_db_close();
+    hash_destroy(&CountDb.counts, free);
+    mutt_str_replace(&CountDb.filename, filename);
+  }
+  if (!CountDb.counts)
+    CountDb.counts = hash_create(64, MUTT_HASH_STRDUP_KEYS);
+
+  memset(&data, 0, sizeof(data));
+  data.db_filename = CountDb.filename;
+  if ((get_database_mtime(&data, &mtime) != 0) || (mtime != CountDb.mtime))
+    count_db_close();
+
+  if (!CountDb.db)
+  {
+    /* don't be verbose about connection, as we're called from
+     * sidebar/buffy very often */
+    CountDb.db = do_database_open(filename, false, false);
+    if (!CountDb.db)
+      return NULL;
+    CountDb.mtime = mtime;
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+    CountDb.version = notmuch_database_get_revision(CountDb.db, NULL);
+#else
+    CountDb.version = mtime;
+#endif
+  }
+  return CountDb.db;
+}
+
 int nm_nonctx_get_count(char *path, int *all, int *new)
 {
   struct UriTag *query_items = NULL, *item = NULL;
-  char *db_filename = NULL, *db_query = NULL;
+  char *db_filename = NULL, *db_query = NULL, *qstr = NULL;
   notmuch_database_t *db = NULL;
+  struct NmCount *count = NULL;
+  struct NmCount once;
+  char key[LONG_STRING];
   int rc = -1, dflt = 0;
 
   mutt_debug(1, "nm: count\n");
@@ -1966,37 +2319,42 @@ int nm_nonctx_get_count(char *path, int *all, int *new)
     dflt = 1;
   }
 
-  /* don't be verbose about connection, as we're called from
-   * sidebar/buffy very often */
-  db = do_database_open(db_filename, false, false);
+  db = count_db_open(db_filename);
   if (!db)
     goto done;
 
-  /* all emails */
-  if (all)
-    *all = count_query(db, db_query);
-
-  /* new messages */
-  if (new)
+  /* Count again only if the database has changed.  The counts also depend
+   * on the tags used, and those of queries with dates on the current time,
+   * so such queries are never cached, as in query_cache_key(). */
+  snprintf(key, sizeof(key), "%s/%s/%s", NONULL(NotmuchUnreadTag),
+           NONULL(NotmuchExcludeTags), db_query);
+  if (strstr(db_query, "date:"))
+    count = &once;
+  else if (!(count = hash_find(CountDb.counts, key)))
   {
-    char *qstr = NULL;
-
-    safe_asprintf(&qstr, "( %s ) tag:%s", db_query, NotmuchUnreadTag);
-    *new = count_query(db, qstr);
-    FREE(&qstr);
+    count = safe_calloc(1, sizeof(struct NmCount));
+    hash_insert(CountDb.counts, key, count);
+  }
+  else if (count->version == CountDb.version)
+  {
+    mutt_debug(1, "nm: count '%s' unchanged\n", db_query);
+    goto found;
   }
 
+  count->version = CountDb.version;
+  count->all = count_query(db, db_query);
+  safe_asprintf(&qstr, "( %s ) tag:%s", db_query, NotmuchUnreadTag);
+  count->new = count_query(db, qstr);
+  FREE(&qstr);
+
+found:
+  if (all)
+    *all = count->all;
+  if (new)
+    *new = count->new;
+
   rc = 0;
 done:
-  if (db)
-  {
-#ifdef NOTMUCH_API_3
-    notmuch_database_destroy(db);
-#else
-    notmuch_database_close(db);
-#endif
-    mutt_debug(1, "nm: count close DB\n");
-  }
   if (!dflt)
     FREE(&db_filename);
   url_free_tags(query_items);
@@ -2123,12 +2481,228 @@ done:
   return rc;
 }
 
+#if defined(USE_HCACHE) && LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+/* first string of a cached query result, to be changed with its format */
+#define QUERY_CACHE_VERSION "nm-query-1"
+
+/**
+ * query_cache_key - Make the header cache key of the results of the query
+ *
+ * Results of queries with dates depend on the current time as well as on the
+ * database, so they're never cached.
+ */
+static size_t query_cache_key(struct NmCtxdata *data, char *buf, size_t bufsz)
+{
+  const char *str = get_query_string(data, true);
+  struct Md5Ctx ctx;
+  char num[SHORT_STRING];
+
+  if (!str || strstr(str, "date:"))
+    return 0;
+
+  snprintf(num, sizeof(num), "%d/%d/", get_query_type(data), get_limit(data));
+  md5_init_ctx(&ctx);
+  md5_process_bytes(num, strlen(num), &ctx);
+  md5_process_bytes(NONULL(NotmuchExcludeTags), mutt_strlen(NotmuchExcludeTags) + 1, &ctx);
+  md5_process_bytes(str, strlen(str), &ctx);
+
+  return cache_key_finish(buf, bufsz, &ctx, "query/");
+}
+
+static void query_cache_put(char **buf, size_t *len, size_t *max, const char *str)
+{
+  size_t sz = strlen(str) + 1;
+
+  if (*len + sz > *max)
+  {
+    *max = (*len + sz) * 2;
+    safe_realloc(buf, *max);
+  }
+  memcpy(*buf + *len, str, sz);
+  *len += sz;
+}
+
+/* tag lists are kept in reverse order */
+static void query_cache_put_tags(char **buf, size_t *len, size_t *max, struct NmHdrtag *tag)
+{
+  if (!tag)
+    return;
+
+  query_cache_put_tags(buf, len, max, tag->next);
+  query_cache_put(buf, len, max, tag->tag);
+}
+
+/**
+ * query_cache_save - Remember the results of the query
+ * @param ctx Context holding the results
+ * @param rev Revision of the database the query has been run against
+ *
+ * The format version, the database UUID, its revision, the number of
+ * messages and the size of the rest are followed by the message-id, path and
+ * tags of every message, all as NUL-terminated strings.  The headers
+ * themselves are in the header cache already.
+ */
+static void query_cache_save(struct Context *ctx, unsigned long rev)
+{
+  struct NmCtxdata *data = get_ctxdata(ctx);
+  char key[LONG_STRING];
+  char path[_POSIX_PATH_MAX];
+  char num[SHORT_STRING];
+  const char *uuid = NULL;
+  char *buf = NULL;
+  char *rec = NULL;
+  size_t keylen, len = 0, max = 0, reclen = 0, recmax = 0;
+
+  keylen = query_cache_key(data, key, sizeof(key));
+  if (!data->hc || !data->db || !keylen)
+    return;
+
+  for (int i = 0; i < ctx->msgcount; i++)
+  {
+    struct Header *h = ctx->hdrs[i];
+    struct NmHdrdata *hd = h->data;
+
+    /* the database has to be told about moved files by nm_sync_mailbox() */
+    if (hd->oldpath)
+    {
+      FREE(&buf);
+      return;
+    }
+
+    query_cache_put(&buf, &len, &max, hd->virtual_id);
+    query_cache_put(&buf, &len, &max, header_get_fullpath(h, path, sizeof(path)));
+    query_cache_put_tags(&buf, &len, &max, hd->tag_list);
+    query_cache_put(&buf, &len, &max, "");
+  }
+
+  notmuch_database_get_revision(data->db, &uuid);
+  snprintf(num, sizeof(num), "%lu %d %zu", rev, ctx->msgcount, len);
+  query_cache_put(&rec, &reclen, &recmax, QUERY_CACHE_VERSION);
+  query_cache_put(&rec, &reclen, &recmax, NONULL(uuid));
+  query_cache_put(&rec, &reclen, &recmax, num);
+  if (reclen + len > recmax)
+    safe_realloc(&rec, reclen + len);
+  if (len)
+    memcpy(rec + reclen, buf, len);
+
+  mutt_debug(1, "nm: caching %d results of revision %lu\n", ctx->msgcount, rev);
+  mutt_hcache_store_raw(data->hc, key, keylen, rec, reclen + len);
+  FREE(&buf);
+  FREE(&rec);
+}
+
+/**
+ * query_cache_read - Rebuild the context from the cached results of the query
+ * @param ctx Context
+ * @param rev Current revision of the database
+ * @retval true The database hasn't changed since the results were cached
+ *
+ * None of the messages has to be looked up in the database or parsed.
+ */
+static bool query_cache_read(struct Context *ctx, unsigned long rev)
+{
+  struct NmCtxdata *data = get_ctxdata(ctx);
+  struct Header **hdrs = NULL;
+  char key[LONG_STRING];
+  const char *uuid = NULL;
+  void *cache = NULL;
+  char *p = NULL;
+  char *end = NULL;
+  unsigned long crev;
+  size_t keylen, len = 0;
+  int i = 0, count = -1;
+
+  keylen = query_cache_key(data, key, sizeof(key));
+  if (!data->hc || !keylen)
+    return false;
+
+  cache = mutt_hcache_fetch_raw(data->hc, key, keylen);
+  if (!cache)
+    return false;
+
+  notmuch_database_get_revision(data->db, &uuid);
+  p = cache;
+  /* the sizes can only be trusted in a record of the current format */
+  if ((strncmp(p, QUERY_CACHE_VERSION, sizeof(QUERY_CACHE_VERSION)) == 0) &&
+      (mutt_strcmp((p += sizeof(QUERY_CACHE_VERSION)), uuid) == 0))
+  {
+    p += strlen(p) + 1;
+    if ((sscanf(p, "%lu %d %zu", &crev, &count, &len) != 3) || (crev != rev) ||
+        ((count > 0) && ((len == 0) || p[strlen(p) + len] != '\0')))
+      count = -1;
+    p += strlen(p) + 1;
+    end = p + len;
+  }
+  if (count < 0)
+  {
+    mutt_hcache_free(data->hc, &cache);
+    return false;
+  }
+
+  hdrs = safe_calloc(count + 1, sizeof(struct Header *));
+  for (i = 0; i < count; i++)
+  {
+    const char *id = p;
+    const char *path = NULL;
+    char *tstr = NULL, *ttstr = NULL;
+    struct NmHdrtag *tag_list = NULL;
+    struct Header *h = NULL;
+
+    /* the last byte of the record is a NUL, so no string runs past it */
+    if ((p >= end) || ((path = (p += strlen(p) + 1)) >= end))
+      break;
+    for (p += strlen(p) + 1; (p < end) && *p; p += strlen(p) + 1)
+      add_header_tag(p, &tag_list, &tstr, &ttstr);
+    p++;
+
+    h = (p <= end) ? hcache_get_header(data->hc, id, path) : NULL;
+    if (!h || (init_header_data(h, path, id) != 0))
+    {
+      free_tag_list(&tag_list);
+      FREE(&tstr);
+      FREE(&ttstr);
+      mutt_free_header(&h);
+      break;
+    }
+    set_header_tags(h, tag_list, tstr, ttstr);
+    hdrs[i] = h;
+  }
+
+  if (i == count)
+  {
+    for (i = 0; i < count; i++)
+      add_header(ctx, hdrs[i]);
+    mutt_debug(1, "nm: %d results of revision %lu from cache\n", count, rev);
+  }
+  else
+  {
+    /* a header is missing from the cache, run the query */
+    while (i > 0)
+      mutt_free_header(&hdrs[--i]);
+    count = -1;
+  }
+
+  FREE(&hdrs);
+  mutt_hcache_free(data->hc, &cache);
+  return count >= 0;
+}
+#else
+static bool query_cache_read(struct Context *ctx, unsigned long rev)
+{
+  return false;
+}
+
+static void query_cache_save(struct Context *ctx, unsigned long rev)
+{
+}
+#endif
 
 static int nm_open_mailbox(struct Context *ctx)
 {
   notmuch_query_t *q = NULL;
   struct NmCtxdata *data = NULL;
-  int rc = -1;
+  unsigned long rev = 0;
+  int count, rc = -1;
 
   if (init_context(ctx) != 0)
     return -1;
@@ -2140,22 +2714,38 @@ static int nm_open_mailbox(struct Context *ctx)
   mutt_debug(1, "nm: reading messages...[current count=%d]\n", ctx->msgcount);
 
   progress_reset(ctx);
+  count = ctx->msgcount;
 
   q = get_query(data, false);
   if (q)
   {
     rc = 0;
-    switch (get_query_type(data))
+#ifdef USE_HCACHE
+    data->hc = hcache_open(data);
+#endif
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+    rev = notmuch_database_get_revision(data->db, NULL);
+#endif
+    if ((count > 0) || !query_cache_read(ctx, rev))
     {
-      case NM_QUERY_TYPE_MESGS:
-        if (!read_mesgs_query(ctx, q, 0))
-          rc = -2;
-        break;
-      case NM_QUERY_TYPE_THREADS:
-        if (!read_threads_query(ctx, q, 0, get_limit(data)))
-          rc = -2;
-        break;
+      switch (get_query_type(data))
+      {
+        case NM_QUERY_TYPE_MESGS:
+          if (!read_mesgs_query(ctx, q, 0))
+            rc = -2;
+          break;
+        case NM_QUERY_TYPE_THREADS:
+          if (!read_threads_query(ctx, q, 0, get_limit(data)))
+            rc = -2;
+          break;
+      }
+      if ((rc == 0) && (count == 0))
+        query_cache_save(ctx, rev);
     }
+#ifdef USE_HCACHE
+    mutt_hcache_close(data->hc);
+    data->hc = NULL;
+#endif
     notmuch_query_destroy(q);
   }
 
@@ -2313,7 +2903,7 @@ static int nm_sync_mailbox(struct Context *ctx, int *index_hint)
   char msgbuf[STRING];
   struct Progress progress;
   char *uri = ctx->path;
-  int changed = 0;
+  int changed = 0, trans = 0;
 
   if (!data)
     return -1;
@@ -2365,6 +2955,10 @@ static int nm_sync_mailbox(struct Context *ctx, int *index_hint)
 
     if (h->deleted || (strcmp(old, new) != 0))
     {
+      /* all the changes go to the database in a single transaction */
+      if (!trans && get_db(data, true))
+        trans = (db_trans_begin(data) > 0);
+
       if (h->deleted && (remove_filename(data, old) == 0))
         changed = 1;
       else if (*new &&*old && (rename_filename(data, old, new, h) == 0))
@@ -2377,6 +2971,8 @@ static int nm_sync_mailbox(struct Context *ctx, int *index_hint)
   ctx->path = uri;
   ctx->magic = MUTT_NOTMUCH;
 
+  if (trans)
+    db_trans_end(data);
   if (!is_longrun(data))
     release_db(data);
   if (changed)
@@ -146,52 +146,97 @@ int mutt_socket_poll(struct Connection *conn)
   return -1;
 }
 
-/* simple read buffering to speed things up. */
-int mutt_socket_readchar(struct Connection *conn, char *c)
+/* socket_fill: refill the connection's input buffer once it has been
+ *   drained. Returns the number of bytes available, or -1 on error. */
+static int socket_fill(struct Connection *conn)
 {
-  if (conn->bufpos >= conn->available)
+  if (conn->bufpos < conn->available)
+    return conn->available - conn->bufpos;
+
+  if (conn->fd >= 0)
+    conn->available = conn->conn_read(conn, conn->inbuf, sizeof(conn->inbuf));
+  else
   {
-    if (conn->fd >= 0)
-      conn->available = conn->conn_read(conn, conn->inbuf, sizeof(conn->inbuf));
-    else
-    {
-      mutt_debug(
-          1, "mutt_socket_readchar: attempt to read from closed connection.\n");
-      return -1;
-    }
-    conn->bufpos = 0;
-    if (conn->available == 0)
-    {
-      mutt_error(_("Connection to %s closed"), conn->account.host);
-      mutt_sleep(2);
-    }
-    if (conn->available <= 0)
-    {
-      mutt_socket_close(conn);
-      return -1;
-    }
+    mutt_debug(1, "socket_fill: attempt to read from closed connection.\n");
+    return -1;
+  }
+  conn->bufpos = 0;
+  if (conn->available == 0)
+  {
+    mutt_error(_("Connection to %s closed"), conn->account.host);
+    mutt_sleep(2);
+  }
+  if (conn->available <= 0)
+  {
+    mutt_socket_close(conn);
+    return -1;
   }
+
+  return conn->available;
+}
+
+/* simple read buffering to speed things up. */
+int mutt_socket_readchar(struct Connection *conn, char *c)
+{
+  if (socket_fill(conn) < 0)
+    return -1;
+
   *c = conn->inbuf[conn->bufpos];
   conn->bufpos++;
   return 1;
 }
 
-int mutt_socket_readln_d(char *buf, size_t buflen, struct Connection *conn, int dbg)
+/* mutt_socket_read: read up to len bytes, copying straight out of the
+ *   connection buffer and refilling it only when it runs dry.
+ *   Returns the number of bytes read (less than len only if the buffer
+ *   had to be refilled and the connection is short of data), or -1. */
+int mutt_socket_read(struct Connection *conn, char *buf, size_t len)
 {
-  char ch;
-  int i;
+  int avail;
+  size_t n;
 
-  for (i = 0; i < buflen - 1; i++)
+  if ((avail = socket_fill(conn)) < 0)
+    return -1;
+
+  n = MIN(len, (size_t) avail);
+  memcpy(buf, conn->inbuf + conn->bufpos, n);
+  conn->bufpos += n;
+
+  return n;
+}
+
+int mutt_socket_readln_d(char *buf, size_t buflen, struct Connection *conn, int dbg)
+{
+  char *nl = NULL;
+  size_t i = 0;
+  size_t n;
+  int avail;
+
+  /* scan the connection buffer a block at a time rather than a character
+   * at a time; the line semantics are the same as reading byte by byte */
+  while (i < buflen - 1)
   {
-    if (mutt_socket_readchar(conn, &ch) != 1)
+    if ((avail = socket_fill(conn)) < 0)
     {
       buf[i] = '\0';
       return -1;
     }
 
-    if (ch == '\n')
+    n = MIN((size_t) avail, buflen - 1 - i);
+    nl = memchr(conn->inbuf + conn->bufpos, '\n', n);
+    if (nl)
+      n = nl - (conn->inbuf + conn->bufpos);
+
+    memcpy(buf + i, conn->inbuf + conn->bufpos, n);
+    conn->bufpos += n;
+    i += n;
+
+    if (nl)
+    {
+      /* consume the newline */
+      conn->bufpos++;
       break;
-    buf[i] = ch;
+    }
   }
 
   /* strip \r from \r\n termination */
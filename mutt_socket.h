@@ -35,7 +35,7 @@ struct Connection
   unsigned int ssf;
   void *data;
 
-  char inbuf[LONG_STRING];
+  char inbuf[HUGE_STRING];
   int bufpos;
 
   int fd;
@@ -55,6 +55,7 @@ int mutt_socket_open(struct Connection *conn);
 int mutt_socket_close(struct Connection *conn);
 int mutt_socket_poll(struct Connection *conn);
 int mutt_socket_readchar(struct Connection *conn, char *c);
+int mutt_socket_read(struct Connection *conn, char *buf, size_t len);
 #define mutt_socket_readln(A, B, C) mutt_socket_readln_d(A, B, C, MUTT_SOCK_LOG_CMD)
 int mutt_socket_readln_d(char *buf, size_t buflen, struct Connection *conn, int dbg);
 #define mutt_socket_write(A, B) mutt_socket_write_d(A, B, -1, MUTT_SOCK_LOG_CMD)
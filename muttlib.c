@@ -47,6 +47,7 @@
 #include "filter.h"
 #include "format_flags.h"
 #include "globals.h"
+#include "hash.h"
 #include "header.h"
 #include "lib.h"
 #include "list.h"
@@ -404,6 +405,7 @@ void mutt_free_header(struct Header **h)
   mutt_free_body(&(*h)->content);
   FREE(&(*h)->maildir_flags);
   FREE(&(*h)->tree);
+  FREE(&(*h)->index_line);
   FREE(&(*h)->path);
 #ifdef MIXMASTER
   mutt_free_list(&(*h)->chain);
@@ -1290,158 +1292,43 @@ char *mutt_apply_replace(char *dbuf, size_t dlen, char *sbuf, struct ReplaceList
 }
 
 
-void mutt_FormatString(char *dest,     /* output buffer */
-                       size_t destlen, /* output buffer len */
-                       size_t col, /* starting column (nonzero when called recursively) */
-                       int cols,           /* maximum columns */
-                       const char *src,    /* template string */
-                       format_t *callback, /* callback for processing */
-                       unsigned long data, /* callback data */
-                       format_flag flags)  /* callback flags */
+/**
+ * struct FormatState - Progress of mutt_FormatString()
+ */
+struct FormatState
+{
+  char *dest;         /* output buffer */
+  size_t destlen;     /* output buffer len, minus room for the \0 */
+  char *wptr;         /* write pointer */
+  size_t wlen;        /* bytes written */
+  size_t col;         /* current screen column */
+  int cols;           /* maximum columns */
+  format_t *callback; /* callback for processing */
+  unsigned long data; /* callback data */
+  format_flag flags;  /* callback flags */
+};
+
+/**
+ * format_interpret - Expand a format string, the slow way
+ * @fs:  State of the expansion
+ * @src: Template string, or the rest of it
+ *
+ * This parses the template as it goes.  It handles everything, including the
+ * cases format_execute() hands over to it.
+ */
+static void format_interpret(struct FormatState *fs, const char *src)
 {
-  char prefix[SHORT_STRING], buf[LONG_STRING], *cp = NULL, *wptr = dest, ch;
+  char prefix[SHORT_STRING], buf[LONG_STRING], *cp = NULL, *wptr = fs->wptr, ch;
   char ifstring[SHORT_STRING], elsestring[SHORT_STRING];
-  size_t wlen, count, len, wid;
-  pid_t pid;
-  FILE *filter = NULL;
-  int n;
-  char *recycler = NULL;
+  char *dest = fs->dest;
+  size_t destlen = fs->destlen;
+  size_t wlen = fs->wlen, col = fs->col, count, len, wid;
+  int cols = fs->cols;
+  format_t *callback = fs->callback;
+  unsigned long data = fs->data;
+  format_flag flags = fs->flags;
 
   prefix[0] = '\0';
-  destlen--; /* save room for the terminal \0 */
-  wlen = ((flags & MUTT_FORMAT_ARROWCURSOR) && option(OPTARROWCURSOR)) ? 3 : 0;
-  col += wlen;
-
-  if ((flags & MUTT_FORMAT_NOFILTER) == 0)
-  {
-    int off = -1;
-
-    /* Do not consider filters if no pipe at end */
-    n = mutt_strlen(src);
-    if (n > 1 && src[n - 1] == '|')
-    {
-      /* Scan backwards for backslashes */
-      off = n;
-      while (off > 0 && src[off - 2] == '\\')
-        off--;
-    }
-
-    /* If number of backslashes is even, the pipe is real. */
-    /* n-off is the number of backslashes. */
-    if (off > 0 && ((n - off) % 2) == 0)
-    {
-      struct Buffer *srcbuf = NULL, *word = NULL, *command = NULL;
-      char srccopy[LONG_STRING];
-#ifdef DEBUG
-      int i = 0;
-#endif
-
-      mutt_debug(3, "fmtpipe = %s\n", src);
-
-      strncpy(srccopy, src, n);
-      srccopy[n - 1] = '\0';
-
-      /* prepare BUFFERs */
-      srcbuf = mutt_buffer_from(srccopy);
-      srcbuf->dptr = srcbuf->data;
-      word = mutt_buffer_new();
-      command = mutt_buffer_new();
-
-      /* Iterate expansions across successive arguments */
-      do
-      {
-        char *p = NULL;
-
-        /* Extract the command name and copy to command line */
-        mutt_debug(3, "fmtpipe +++: %s\n", srcbuf->dptr);
-        if (word->data)
-          *word->data = '\0';
-        mutt_extract_token(word, srcbuf, 0);
-        mutt_debug(3, "fmtpipe %2d: %s\n", i++, word->data);
-        mutt_buffer_addch(command, '\'');
-        mutt_FormatString(buf, sizeof(buf), 0, cols, word->data, callback, data,
-                          flags | MUTT_FORMAT_NOFILTER);
-        for (p = buf; p && *p; p++)
-        {
-          if (*p == '\'')
-            /* shell quoting doesn't permit escaping a single quote within
-             * single-quoted material.  double-quoting instead will lead
-             * shell variable expansions, so break out of the single-quoted
-             * span, insert a double-quoted single quote, and resume. */
-            mutt_buffer_addstr(command, "'\"'\"'");
-          else
-            mutt_buffer_addch(command, *p);
-        }
-        mutt_buffer_addch(command, '\'');
-        mutt_buffer_addch(command, ' ');
-      } while (MoreArgs(srcbuf));
-
-      mutt_debug(3, "fmtpipe > %s\n", command->data);
-
-      col -= wlen; /* reset to passed in value */
-      wptr = dest; /* reset write ptr */
-      wlen = ((flags & MUTT_FORMAT_ARROWCURSOR) && option(OPTARROWCURSOR)) ? 3 : 0;
-      if ((pid = mutt_create_filter(command->data, NULL, &filter, NULL)) != -1)
-      {
-        int rc;
-
-        n = fread(dest, 1, destlen /* already decremented */, filter);
-        safe_fclose(&filter);
-        rc = mutt_wait_filter(pid);
-        if (rc != 0)
-          mutt_debug(1, "format pipe command exited code %d\n", rc);
-        if (n > 0)
-        {
-          dest[n] = 0;
-          while ((n > 0) && (dest[n - 1] == '\n' || dest[n - 1] == '\r'))
-            dest[--n] = '\0';
-          mutt_debug(3, "fmtpipe < %s\n", dest);
-
-          /* If the result ends with '%', this indicates that the filter
-           * generated %-tokens that mutt can expand.  Eliminate the '%'
-           * marker and recycle the string through mutt_FormatString().
-           * To literally end with "%", use "%%". */
-          if ((n > 0) && dest[n - 1] == '%')
-          {
-            --n;
-            dest[n] = '\0'; /* remove '%' */
-            if ((n > 0) && dest[n - 1] != '%')
-            {
-              recycler = safe_strdup(dest);
-              if (recycler)
-              {
-                /* destlen is decremented at the start of this function
-                 * to save space for the terminal nul char.  We can add
-                 * it back for the recursive call since the expansion of
-                 * format pipes does not try to append a nul itself.
-                 */
-                mutt_FormatString(dest, destlen + 1, col, cols, recycler,
-                                  callback, data, flags);
-                FREE(&recycler);
-              }
-            }
-          }
-        }
-        else
-        {
-          /* read error */
-          mutt_debug(1, "error reading from fmtpipe: %s (errno=%d)\n",
-                     strerror(errno), errno);
-          *wptr = 0;
-        }
-      }
-      else
-      {
-        /* Filter failed; erase write buffer */
-        *wptr = '\0';
-      }
-
-      mutt_buffer_free(&command);
-      mutt_buffer_free(&srcbuf);
-      mutt_buffer_free(&word);
-      return;
-    }
-  }
 
   while (*src && wlen < destlen)
   {
@@ -1775,7 +1662,593 @@ void mutt_FormatString(char *dest,     /* output buffer */
       }
     }
   }
-  *wptr = 0;
+
+  fs->wptr = wptr;
+  fs->wlen = wlen;
+  fs->col = col;
+  fs->flags = flags;
+}
+
+/**
+ * enum FormatOpType - Types of FormatOp
+ */
+enum FormatOpType
+{
+  FOP_END = 0,   /* end of the template */
+  FOP_TEXT,      /* literal text */
+  FOP_CHAR,      /* a single byte, from "%%" or an escape like "\n" */
+  FOP_EXPANDO,   /* an expando handled by the callback */
+  FOP_INTERPRET, /* hand the rest over to format_interpret() */
+};
+
+/**
+ * struct FormatOp - One step of a compiled format string
+ */
+struct FormatOp
+{
+  enum FormatOpType type;
+  size_t start;     /* offset of the op in the template */
+  size_t len;       /* FOP_TEXT: length in bytes */
+  int width;        /* FOP_TEXT: width in screen columns */
+  char ch;          /* FOP_CHAR: byte; FOP_EXPANDO: expando character */
+  bool optional;    /* FOP_EXPANDO: %<x?if&else> */
+  bool tolower;     /* FOP_EXPANDO: %_x */
+  bool nodots;      /* FOP_EXPANDO: %:x */
+  size_t arg;       /* FOP_EXPANDO: offset passed to the callback as src */
+  char *prefix;     /* FOP_EXPANDO: width, justification, etc. */
+  char *ifstring;   /* FOP_EXPANDO: `if' part of an optional expando */
+  char *elsestring; /* FOP_EXPANDO: `else' part of an optional expando */
+};
+
+/**
+ * struct FormatTemplate - A compiled format string
+ *
+ * The template is parsed once into a list of ops, which is run by
+ * format_execute().  Anything unusual (padding, bad or oversized formats) is
+ * left to format_interpret(), using FOP_INTERPRET.
+ */
+struct FormatTemplate
+{
+  char *text;           /* copy of the template, as the callbacks see it */
+  struct FormatOp *ops; /* ops, ending with FOP_END or FOP_INTERPRET */
+};
+
+/* Compiled templates, keyed by format string */
+static struct Hash *FormatCache = NULL;
+/* Number of format_execute()s in progress, FormatCache mustn't be flushed */
+static int FormatDepth = 0;
+
+#define FORMAT_CACHE_MAX 256
+
+static void format_free_template(void *data)
+{
+  struct FormatTemplate *tpl = data;
+
+  for (struct FormatOp *op = tpl->ops; op->type != FOP_END; op++)
+  {
+    FREE(&op->prefix);
+    FREE(&op->ifstring);
+    FREE(&op->elsestring);
+    if (op->type == FOP_INTERPRET)
+      break;
+  }
+  FREE(&tpl->ops);
+  FREE(&tpl->text);
+  FREE(&tpl);
+}
+
+/**
+ * format_copy_branch - Copy the `if' or `else' part of an optional expando
+ * @src:      Template, pointing at the start of the part
+ * @lrbalance: Nesting level, updated
+ * @dest:     Copy of the part (NULL if it's empty)
+ *
+ * This follows the parsing of format_interpret().
+ *
+ * Returns:
+ *       0: Success, src is moved past the part
+ *      -1: The part is too long, or broken
+ */
+static int format_copy_branch(char **src, int *lrbalance, char **dest)
+{
+  char part[SHORT_STRING];
+  char *s = *src, *cp = part;
+
+  while ((*lrbalance > 0) && *s)
+  {
+    /* an escape copies two characters */
+    if ((cp - part) >= (sizeof(part) - 3))
+      return -1;
+    if (*s == '\\')
+    {
+      if (!s[1] || !s[2])
+        return -1;
+      s++;
+      *cp++ = *s++;
+    }
+    else if ((s[0] == '%') && (s[1] == '<'))
+    {
+      (*lrbalance)++;
+    }
+    else if (s[0] == '>')
+    {
+      (*lrbalance)--;
+    }
+    if (*lrbalance == 0)
+      break;
+    if ((*lrbalance == 1) && (s[0] == '&'))
+      break;
+    *cp++ = *s++;
+  }
+  *cp = 0;
+
+  *src = s;
+  *dest = safe_strdup(part);
+  return 0;
+}
+
+/**
+ * format_compile - Compile a format string
+ * @src: Template string
+ *
+ * Returns: Compiled template
+ */
+static struct FormatTemplate *format_compile(const char *src)
+{
+  struct FormatTemplate *tpl = safe_calloc(1, sizeof(struct FormatTemplate));
+  struct FormatOp *op = NULL;
+  size_t nops = 0, maxops = 8;
+  char *s = NULL;
+
+  tpl->text = safe_strdup(src);
+  tpl->ops = safe_calloc(maxops, sizeof(struct FormatOp));
+  s = tpl->text;
+
+  while (true)
+  {
+    if (nops == maxops)
+    {
+      maxops *= 2;
+      safe_realloc(&tpl->ops, maxops * sizeof(struct FormatOp));
+    }
+    op = &tpl->ops[nops++];
+    memset(op, 0, sizeof(struct FormatOp));
+    op->start = s - tpl->text;
+
+    if (!*s)
+    {
+      op->type = FOP_END;
+      break;
+    }
+
+    if (*s == '%')
+    {
+      char prefix[SHORT_STRING], *cp = prefix;
+      size_t count = 0;
+
+      s++;
+      if (*s == '%')
+      {
+        op->type = FOP_CHAR;
+        op->ch = '%';
+        s++;
+        continue;
+      }
+
+      if (*s == '?')
+      {
+        /* change original %? to new %< notation, as format_interpret() does */
+        char *p = s;
+        *p = '<';
+        for (; *p && *p != '?'; p++)
+          ;
+        if (*p == '?')
+          p++;
+        for (; *p && *p != '?'; p++)
+          ;
+        if (*p == '?')
+          *p = '>';
+      }
+
+      if (*s == '<')
+      {
+        op->optional = true;
+        op->ch = *(++s);
+        if (!*s)
+          goto interpret;
+        s++;
+        while (*s != '?')
+        {
+          if (!*s || (count >= (sizeof(prefix) - 1)))
+            goto interpret;
+          *cp++ = *s++;
+          count++;
+        }
+        *cp = 0;
+
+        /* eat the `if' and `else' parts of the string */
+        int lrbalance = 1;
+        s++;
+        if (format_copy_branch(&s, &lrbalance, &op->ifstring) < 0)
+          goto interpret;
+        if (*s == '&')
+          s++;
+        if ((format_copy_branch(&s, &lrbalance, &op->elsestring) < 0) || !*s)
+          goto interpret;
+        s++; /* move past the trailing `>' (formerly '?') */
+      }
+      else
+      {
+        while (isdigit((unsigned char) *s) || *s == '.' || *s == '-' || *s == '=')
+        {
+          if (count >= (sizeof(prefix) - 1))
+            goto interpret;
+          *cp++ = *s++;
+          count++;
+        }
+        *cp = 0;
+
+        if (!*s)
+          goto interpret; /* bad format */
+        op->ch = *s++;
+      }
+
+      /* padding is rare, and ends the template */
+      if ((op->ch == '>') || (op->ch == '*') || (op->ch == '|'))
+        goto interpret;
+
+      while (op->ch == '_' || op->ch == ':')
+      {
+        if (op->ch == '_')
+          op->tolower = true;
+        else
+          op->nodots = true;
+
+        if (!*s)
+          goto interpret;
+        op->ch = *s++;
+      }
+
+      op->type = FOP_EXPANDO;
+      op->prefix = safe_strdup(prefix);
+      op->arg = s - tpl->text;
+    }
+    else if (*s == '\\')
+    {
+      if (!s[1])
+        goto interpret;
+      s++;
+      switch (*s)
+      {
+        case 'n':
+          op->ch = '\n';
+          break;
+        case 't':
+          op->ch = '\t';
+          break;
+        case 'r':
+          op->ch = '\r';
+          break;
+        case 'f':
+          op->ch = '\f';
+          break;
+        case 'v':
+          op->ch = '\v';
+          break;
+        default:
+          op->ch = *s;
+          break;
+      }
+      op->type = FOP_CHAR;
+      s++;
+    }
+    else
+    {
+      int tmp, w;
+
+      op->type = FOP_TEXT;
+      while (*s && (*s != '%') && (*s != '\\'))
+      {
+        if ((tmp = mutt_charlen(s, &w)) < 0)
+          tmp = w = 1;
+        s += tmp;
+        op->len += tmp;
+        op->width += w;
+      }
+    }
+  }
+
+  return tpl;
+
+interpret:
+  FREE(&op->ifstring);
+  FREE(&op->elsestring);
+  op->type = FOP_INTERPRET;
+  return tpl;
+}
+
+/**
+ * format_get_template - Get the compiled version of a format string
+ * @src: Template string
+ *
+ * Templates are compiled the first time they're used and kept until the
+ * cache fills up.
+ *
+ * Returns: Compiled template
+ */
+static struct FormatTemplate *format_get_template(const char *src)
+{
+  struct FormatTemplate *tpl = NULL;
+
+  if (FormatCache && (FormatCache->curnelem >= FORMAT_CACHE_MAX) && (FormatDepth == 0))
+    hash_destroy(&FormatCache, format_free_template);
+  if (!FormatCache)
+    FormatCache = hash_create(FORMAT_CACHE_MAX, MUTT_HASH_STRDUP_KEYS);
+
+  tpl = hash_find(FormatCache, src);
+  if (!tpl)
+  {
+    tpl = format_compile(src);
+    hash_insert(FormatCache, src, tpl);
+  }
+
+  return tpl;
+}
+
+/**
+ * format_execute - Expand a compiled format string
+ * @fs:  State of the expansion
+ * @tpl: Compiled template
+ *
+ * This does the same as format_interpret(), without parsing the template.
+ */
+static void format_execute(struct FormatState *fs, struct FormatTemplate *tpl)
+{
+  char buf[LONG_STRING];
+  const struct FormatOp *op = tpl->ops;
+  const char *src = NULL;
+  size_t len;
+
+  while (fs->wlen < fs->destlen)
+  {
+    switch (op->type)
+    {
+      case FOP_END:
+        return;
+
+      case FOP_INTERPRET:
+        format_interpret(fs, tpl->text + op->start);
+        return;
+
+      case FOP_TEXT:
+        /* not enough room, let format_interpret() truncate it */
+        if (fs->wlen + op->len >= fs->destlen)
+        {
+          format_interpret(fs, tpl->text + op->start);
+          return;
+        }
+        memcpy(fs->wptr, tpl->text + op->start, op->len);
+        fs->wptr += op->len;
+        fs->wlen += op->len;
+        fs->col += op->width;
+        op++;
+        break;
+
+      case FOP_CHAR:
+        *fs->wptr++ = op->ch;
+        fs->wlen++;
+        fs->col++;
+        op++;
+        break;
+
+      case FOP_EXPANDO:
+        if (op->optional)
+          fs->flags |= MUTT_FORMAT_OPTIONAL;
+        else
+          fs->flags &= ~MUTT_FORMAT_OPTIONAL;
+
+        src = fs->callback(buf, sizeof(buf), fs->col, fs->cols, op->ch,
+                           tpl->text + op->arg, NONULL(op->prefix), NONULL(op->ifstring),
+                           NONULL(op->elsestring), fs->data, fs->flags);
+
+        if (op->tolower)
+          mutt_strlower(buf);
+        if (op->nodots)
+        {
+          char *p = buf;
+          for (; *p; p++)
+            if (*p == '.')
+              *p = '_';
+        }
+
+        if ((len = mutt_strlen(buf)) + fs->wlen > fs->destlen)
+          len = mutt_wstr_trunc(buf, fs->destlen - fs->wlen, fs->cols - fs->col, NULL);
+
+        memcpy(fs->wptr, buf, len);
+        fs->wptr += len;
+        fs->wlen += len;
+        fs->col += mutt_strwidth(buf);
+        op++;
+
+        /* the callback may have eaten some of the template, e.g. %{...} */
+        if (src != tpl->text + op->start)
+        {
+          if (*src)
+            format_interpret(fs, src);
+          return;
+        }
+        break;
+    }
+  }
+}
+
+void mutt_FormatString(char *dest,     /* output buffer */
+                       size_t destlen, /* output buffer len */
+                       size_t col, /* starting column (nonzero when called recursively) */
+                       int cols,           /* maximum columns */
+                       const char *src,    /* template string */
+                       format_t *callback, /* callback for processing */
+                       unsigned long data, /* callback data */
+                       format_flag flags)  /* callback flags */
+{
+  char buf[LONG_STRING], *wptr = dest;
+  size_t wlen;
+  pid_t pid;
+  FILE *filter = NULL;
+  int n;
+  char *recycler = NULL;
+
+  destlen--; /* save room for the terminal \0 */
+  wlen = ((flags & MUTT_FORMAT_ARROWCURSOR) && option(OPTARROWCURSOR)) ? 3 : 0;
+  col += wlen;
+
+  if ((flags & MUTT_FORMAT_NOFILTER) == 0)
+  {
+    int off = -1;
+
+    /* Do not consider filters if no pipe at end */
+    n = mutt_strlen(src);
+    if (n > 1 && src[n - 1] == '|')
+    {
+      /* Scan backwards for backslashes */
+      off = n;
+      while (off > 0 && src[off - 2] == '\\')
+        off--;
+    }
+
+    /* If number of backslashes is even, the pipe is real. */
+    /* n-off is the number of backslashes. */
+    if (off > 0 && ((n - off) % 2) == 0)
+    {
+      struct Buffer *srcbuf = NULL, *word = NULL, *command = NULL;
+      char srccopy[LONG_STRING];
+#ifdef DEBUG
+      int i = 0;
+#endif
+
+      mutt_debug(3, "fmtpipe = %s\n", src);
+
+      strncpy(srccopy, src, n);
+      srccopy[n - 1] = '\0';
+
+      /* prepare BUFFERs */
+      srcbuf = mutt_buffer_from(srccopy);
+      srcbuf->dptr = srcbuf->data;
+      word = mutt_buffer_new();
+      command = mutt_buffer_new();
+
+      /* Iterate expansions across successive arguments */
+      do
+      {
+        char *p = NULL;
+
+        /* Extract the command name and copy to command line */
+        mutt_debug(3, "fmtpipe +++: %s\n", srcbuf->dptr);
+        if (word->data)
+          *word->data = '\0';
+        mutt_extract_token(word, srcbuf, 0);
+        mutt_debug(3, "fmtpipe %2d: %s\n", i++, word->data);
+        mutt_buffer_addch(command, '\'');
+        mutt_FormatString(buf, sizeof(buf), 0, cols, word->data, callback, data,
+                          flags | MUTT_FORMAT_NOFILTER);
+        for (p = buf; p && *p; p++)
+        {
+          if (*p == '\'')
+            /* shell quoting doesn't permit escaping a single quote within
+             * single-quoted material.  double-quoting instead will lead
+             * shell variable expansions, so break out of the single-quoted
+             * span, insert a double-quoted single quote, and resume. */
+            mutt_buffer_addstr(command, "'\"'\"'");
+          else
+            mutt_buffer_addch(command, *p);
+        }
+        mutt_buffer_addch(command, '\'');
+        mutt_buffer_addch(command, ' ');
+      } while (MoreArgs(srcbuf));
+
+      mutt_debug(3, "fmtpipe > %s\n", command->data);
+
+      col -= wlen; /* reset to passed in value */
+      wptr = dest; /* reset write ptr */
+      wlen = ((flags & MUTT_FORMAT_ARROWCURSOR) && option(OPTARROWCURSOR)) ? 3 : 0;
+      if ((pid = mutt_create_filter(command->data, NULL, &filter, NULL)) != -1)
+      {
+        int rc;
+
+        n = fread(dest, 1, destlen /* already decremented */, filter);
+        safe_fclose(&filter);
+        rc = mutt_wait_filter(pid);
+        if (rc != 0)
+          mutt_debug(1, "format pipe command exited code %d\n", rc);
+        if (n > 0)
+        {
+          dest[n] = 0;
+          while ((n > 0) && (dest[n - 1] == '\n' || dest[n - 1] == '\r'))
+            dest[--n] = '\0';
+          mutt_debug(3, "fmtpipe < %s\n", dest);
+
+          /* If the result ends with '%', this indicates that the filter
+           * generated %-tokens that mutt can expand.  Eliminate the '%'
+           * marker and recycle the string through mutt_FormatString().
+           * To literally end with "%", use "%%". */
+          if ((n > 0) && dest[n - 1] == '%')
+          {
+            --n;
+            dest[n] = '\0'; /* remove '%' */
+            if ((n > 0) && dest[n - 1] != '%')
+            {
+              recycler = safe_strdup(dest);
+              if (recycler)
+              {
+                /* destlen is decremented at the start of this function
+                 * to save space for the terminal nul char.  We can add
+                 * it back for the recursive call since the expansion of
+                 * format pipes does not try to append a nul itself.
+                 */
+                mutt_FormatString(dest, destlen + 1, col, cols, recycler,
+                                  callback, data, flags);
+                FREE(&recycler);
+              }
+            }
+          }
+        }
+        else
+        {
+          /* read error */
+          mutt_debug(1, "error reading from fmtpipe: %s (errno=%d)\n",
+                     strerror(errno), errno);
+          *wptr = 0;
+        }
+      }
+      else
+      {
+        /* Filter failed; erase write buffer */
+        *wptr = '\0';
+      }
+
+      mutt_buffer_free(&command);
+      mutt_buffer_free(&srcbuf);
+      mutt_buffer_free(&word);
+      return;
+    }
+  }
+
+  struct FormatState fs = {
+    dest, destlen, wptr, wlen, col, cols, callback, data, flags,
+  };
+  /* the hash can't hold an empty key, and there's nothing to compile */
+  struct FormatTemplate *tpl = *src ? format_get_template(src) : NULL;
+
+  if (tpl)
+  {
+    FormatDepth++;
+    format_execute(&fs, tpl);
+    FormatDepth--;
+  }
+  else
+    format_interpret(&fs, src);
+
+  *fs.wptr = 0;
 }
 
 /* This function allows the user to specify a command to read stdout from in
@@ -1087,6 +1087,7 @@ void mx_update_tables(struct Context *ctx, int committing)
   ctx->unread = 0;
   ctx->changed = false;
   ctx->flagged = 0;
+  IndexGeneration++;
 #define this_body ctx->hdrs[j]->content
   for (i = 0, j = 0; i < ctx->msgcount; i++)
   {
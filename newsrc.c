@@ -20,10 +20,12 @@
 #include "config.h"
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -36,6 +38,7 @@
 #include "hash.h"
 #include "header.h"
 #include "lib.h"
+#include "md5.h"
 #include "mutt_curses.h"
 #include "mutt_socket.h"
 #include "mx.h"
@@ -50,6 +53,228 @@
 
 struct BodyCache;
 
+/* The binary caches (.active.bin and .newsrc.bin in the server's cache
+ * directory) start with this header, followed by the records of all
+ * newsgroups encoded as variable-length integers and NUL-terminated
+ * strings.  Read ranges are stored as differences from the previous
+ * number, so that long lists of ranges take a few bytes each. */
+#define NNTP_ACTIVE_MAGIC "nntp-active 1\n"
+#define NNTP_NEWSRC_MAGIC "nntp-newsrc 1\n"
+
+struct NntpCacheHeader
+{
+  char magic[16];
+  uint64_t size;  /* .newsrc size */
+  int64_t mtime;  /* .newsrc mtime or time of the list of newsgroups */
+  uint64_t ino;   /* .newsrc inode */
+  unsigned char digest[16]; /* md5 of .newsrc */
+  uint32_t count; /* number of newsgroups */
+  uint32_t pad;
+  uint64_t len;   /* length of the records */
+};
+
+struct NntpCacheBuf
+{
+  unsigned char *data;
+  size_t len;
+  size_t max;
+};
+
+struct NntpCacheMap
+{
+  const unsigned char *p;
+  const unsigned char *end;
+  bool error;
+};
+
+static void cache_put(struct NntpCacheBuf *buf, const void *data, size_t len)
+{
+  if (buf->len + len > buf->max)
+  {
+    buf->max = (buf->len + len) * 2;
+    safe_realloc(&buf->data, buf->max);
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+}
+
+static void cache_put_num(struct NntpCacheBuf *buf, uint64_t num)
+{
+  unsigned char c;
+
+  do
+  {
+    c = num & 0x7f;
+    num >>= 7;
+    if (num)
+      c |= 0x80;
+    cache_put(buf, &c, 1);
+  } while (num);
+}
+
+/* Store the difference between two article numbers, which may be negative */
+static void cache_put_delta(struct NntpCacheBuf *buf, anum_t prev, anum_t num)
+{
+  int64_t delta = (int64_t) num - prev;
+
+  cache_put_num(buf, delta < 0 ? ((uint64_t) -delta << 1) - 1 : (uint64_t) delta << 1);
+}
+
+static void cache_put_str(struct NntpCacheBuf *buf, const char *str)
+{
+  size_t len = mutt_strlen(str);
+
+  cache_put_num(buf, len);
+  cache_put(buf, NONULL(str), len);
+  cache_put(buf, "", 1);
+}
+
+static uint64_t cache_get_num(struct NntpCacheMap *map)
+{
+  uint64_t num = 0;
+
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    if (map->p >= map->end)
+      break;
+    num |= (uint64_t)(*map->p & 0x7f) << shift;
+    if (!(*map->p++ & 0x80))
+      return num;
+  }
+  map->error = true;
+  return 0;
+}
+
+static anum_t cache_get_delta(struct NntpCacheMap *map, anum_t prev)
+{
+  uint64_t num = cache_get_num(map);
+  int64_t delta = num & 1 ? -(int64_t)((num + 1) >> 1) : (int64_t)(num >> 1);
+
+  return prev + delta;
+}
+
+static const char *cache_get_str(struct NntpCacheMap *map)
+{
+  uint64_t len = cache_get_num(map);
+  const char *str = (const char *) map->p;
+
+  if (map->error || len >= (uint64_t)(map->end - map->p) || map->p[len])
+  {
+    map->error = true;
+    return "";
+  }
+  map->p += len + 1;
+  return str;
+}
+
+/* Map binary cache file and check its header */
+static void *cache_map(const char *file, const char *magic,
+                       struct NntpCacheHeader *hdr, size_t *maplen)
+{
+  struct stat sb;
+  void *data = NULL;
+  int fd;
+
+  fd = open(file, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &sb) == 0 && sb.st_size >= sizeof(*hdr))
+  {
+    data = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+      data = NULL;
+  }
+  close(fd);
+  if (!data)
+    return NULL;
+
+  memcpy(hdr, data, sizeof(*hdr));
+  if (strncmp(hdr->magic, magic, sizeof(hdr->magic)) != 0 ||
+      hdr->len != sb.st_size - sizeof(*hdr))
+  {
+    mutt_debug(1, "cache_map: %s is invalid\n", file);
+    munmap(data, sb.st_size);
+    return NULL;
+  }
+  *maplen = sb.st_size;
+  return data;
+}
+
+/* Update file with new contents */
+static int update_file(char *filename, const void *buf, size_t len)
+{
+  FILE *fp = NULL;
+  char tmpfile[_POSIX_PATH_MAX];
+  int rc = -1;
+
+  while (1)
+  {
+    snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", filename);
+    fp = safe_fopen(tmpfile, "w");
+    if (!fp)
+    {
+      mutt_perror(tmpfile);
+      *tmpfile = '\0';
+      break;
+    }
+    if (fwrite(buf, 1, len, fp) != len)
+    {
+      mutt_perror(tmpfile);
+      break;
+    }
+    if (safe_fclose(&fp) == EOF)
+    {
+      mutt_perror(tmpfile);
+      fp = NULL;
+      break;
+    }
+    fp = NULL;
+    if (rename(tmpfile, filename) < 0)
+    {
+      mutt_perror(filename);
+      break;
+    }
+    *tmpfile = '\0';
+    rc = 0;
+    break;
+  }
+  if (fp)
+    safe_fclose(&fp);
+  if (*tmpfile)
+    unlink(tmpfile);
+  if (rc)
+    mutt_sleep(2);
+  return rc;
+}
+
+/* Make fully qualified cache file name */
+static void cache_expand(char *dst, size_t dstlen, struct Account *acct, char *src)
+{
+  char *c = NULL;
+  char file[_POSIX_PATH_MAX];
+
+  /* server subdirectory */
+  if (acct)
+  {
+    struct CissUrl url;
+
+    mutt_account_tourl(acct, &url);
+    url.path = src;
+    url_ciss_tostring(&url, file, sizeof(file), U_PATH);
+  }
+  else
+    strfcpy(file, src ? src : "", sizeof(file));
+
+  snprintf(dst, dstlen, "%s/%s", NewsCacheDir, file);
+
+  /* remove trailing slash */
+  c = dst + strlen(dst) - 1;
+  if (*c == '/')
+    *c = '\0';
+  mutt_expand_path(dst, dstlen);
+}
+
 /* Find NntpData for given newsgroup or add it */
 static struct NntpData *nntp_data_find(struct NntpServer *nserv, const char *group)
 {
@@ -141,6 +366,132 @@ void nntp_group_unread_stat(struct NntpData *nntp_data)
   }
 }
 
+/* Save read ranges to the binary cache of .newsrc described by sb */
+static void newsrc_save_cache(struct NntpServer *nserv, struct stat *sb)
+{
+  struct NntpCacheHeader hdr;
+  struct NntpCacheBuf buf;
+  char file[_POSIX_PATH_MAX];
+
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.magic, NNTP_NEWSRC_MAGIC, sizeof(hdr.magic));
+  hdr.size = sb->st_size;
+  hdr.mtime = sb->st_mtime;
+  hdr.ino = sb->st_ino;
+  memcpy(hdr.digest, nserv->newsrc_digest, sizeof(hdr.digest));
+
+  memset(&buf, 0, sizeof(buf));
+  cache_put(&buf, &hdr, sizeof(hdr));
+  for (unsigned int i = 0; i < nserv->groups_num; i++)
+  {
+    struct NntpData *nntp_data = nserv->groups_list[i];
+    anum_t prev = 0;
+
+    if (!nntp_data || !nntp_data->newsrc_ent)
+      continue;
+
+    cache_put_str(&buf, nntp_data->group);
+    cache_put_num(&buf, nntp_data->subscribed);
+    cache_put_num(&buf, nntp_data->newsrc_len);
+    for (unsigned int j = 0; j < nntp_data->newsrc_len; j++)
+    {
+      cache_put_delta(&buf, prev, nntp_data->newsrc_ent[j].first);
+      cache_put_delta(&buf, nntp_data->newsrc_ent[j].first, nntp_data->newsrc_ent[j].last);
+      prev = nntp_data->newsrc_ent[j].last;
+    }
+    hdr.count++;
+  }
+  hdr.len = buf.len - sizeof(hdr);
+  memcpy(buf.data, &hdr, sizeof(hdr));
+
+  cache_expand(file, sizeof(file), &nserv->conn->account, ".newsrc.bin");
+  mutt_debug(1, "Updating %s\n", file);
+  update_file(file, buf.data, buf.len);
+  FREE(&buf.data);
+}
+
+/* Load read ranges from the binary cache if it was made from the very
+ * .newsrc described by sb */
+static int newsrc_get_cache(struct NntpServer *nserv, struct stat *sb)
+{
+  struct NntpCacheHeader hdr;
+  struct NntpCacheMap map;
+  char file[_POSIX_PATH_MAX];
+  void *data = NULL;
+  size_t len;
+
+  cache_expand(file, sizeof(file), &nserv->conn->account, ".newsrc.bin");
+  data = cache_map(file, NNTP_NEWSRC_MAGIC, &hdr, &len);
+  if (!data)
+    return -1;
+  if (hdr.size != sb->st_size || hdr.mtime != sb->st_mtime || hdr.ino != sb->st_ino)
+  {
+    munmap(data, len);
+    return -1;
+  }
+  mutt_debug(1, "Loading %s\n", file);
+
+  /* check the records before touching any newsgroup */
+  for (int apply = 0; apply < 2; apply++)
+  {
+    map.p = (unsigned char *) data + sizeof(hdr);
+    map.end = (unsigned char *) data + len;
+    map.error = false;
+
+    for (uint32_t i = 0; i < hdr.count && !map.error; i++)
+    {
+      struct NntpData *nntp_data = NULL;
+      const char *group = cache_get_str(&map);
+      bool subs = cache_get_num(&map);
+      uint64_t n = cache_get_num(&map);
+      anum_t prev = 0;
+
+      /* every range takes two bytes at least */
+      if (n == 0 || n > (uint64_t)(map.end - map.p) / 2)
+        map.error = true;
+      if (map.error)
+        break;
+
+      if (apply)
+      {
+        nntp_data = nntp_data_find(nserv, group);
+        FREE(&nntp_data->newsrc_ent);
+        nntp_data->newsrc_ent = safe_calloc(n, sizeof(struct NewsrcEntry));
+        nntp_data->newsrc_len = n;
+        nntp_data->subscribed = subs;
+      }
+      for (uint64_t j = 0; j < n; j++)
+      {
+        anum_t first = cache_get_delta(&map, prev);
+        anum_t last = cache_get_delta(&map, first);
+
+        if (apply)
+        {
+          nntp_data->newsrc_ent[j].first = first;
+          nntp_data->newsrc_ent[j].last = last;
+        }
+        prev = last;
+      }
+      if (apply)
+      {
+        if (nntp_data->lastMessage == 0)
+          nntp_data->lastMessage = prev;
+        nntp_group_unread_stat(nntp_data);
+      }
+    }
+    if (map.error || map.p != map.end)
+    {
+      mutt_debug(1, "newsrc_get_cache: %s is corrupted\n", file);
+      munmap(data, len);
+      return -1;
+    }
+  }
+
+  memcpy(nserv->newsrc_digest, hdr.digest, sizeof(nserv->newsrc_digest));
+  munmap(data, len);
+  return 0;
+}
+
 /* Parse .newsrc file:
  *  0 - not changed
  *  1 - parsed
@@ -208,6 +559,13 @@ int nntp_newsrc_parse(struct NntpServer *nserv)
     FREE(&nntp_data->newsrc_ent);
   }
 
+  /* read ranges of this .newsrc are in the cache already */
+  if (nserv->cacheable && newsrc_get_cache(nserv, &sb) == 0)
+    return 1;
+
+  md5_stream(nserv->newsrc_fp, nserv->newsrc_digest);
+  rewind(nserv->newsrc_fp);
+
   line = safe_malloc(sb.st_size + 1);
   while (sb.st_size && fgets(line, sb.st_size + 1, nserv->newsrc_fp))
   {
@@ -274,6 +632,9 @@ int nntp_newsrc_parse(struct NntpServer *nserv)
     mutt_debug(2, "nntp_newsrc_parse: %s\n", nntp_data->group);
   }
   FREE(&line);
+
+  if (nserv->cacheable)
+    newsrc_save_cache(nserv, &sb);
   return 1;
 }
 
@@ -359,58 +720,13 @@ void nntp_newsrc_gen_entries(struct Context *ctx)
   }
 }
 
-/* Update file with new contents */
-static int update_file(char *filename, char *buf)
-{
-  FILE *fp = NULL;
-  char tmpfile[_POSIX_PATH_MAX];
-  int rc = -1;
-
-  while (1)
-  {
-    snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", filename);
-    fp = safe_fopen(tmpfile, "w");
-    if (!fp)
-    {
-      mutt_perror(tmpfile);
-      *tmpfile = '\0';
-      break;
-    }
-    if (fputs(buf, fp) == EOF)
-    {
-      mutt_perror(tmpfile);
-      break;
-    }
-    if (safe_fclose(&fp) == EOF)
-    {
-      mutt_perror(tmpfile);
-      fp = NULL;
-      break;
-    }
-    fp = NULL;
-    if (rename(tmpfile, filename) < 0)
-    {
-      mutt_perror(filename);
-      break;
-    }
-    *tmpfile = '\0';
-    rc = 0;
-    break;
-  }
-  if (fp)
-    safe_fclose(&fp);
-  if (*tmpfile)
-    unlink(tmpfile);
-  if (rc)
-    mutt_sleep(2);
-  return rc;
-}
-
 /* Update .newsrc file */
 int nntp_newsrc_update(struct NntpServer *nserv)
 {
   char *buf = NULL;
   size_t buflen, off;
+  unsigned char digest[16];
+  struct stat sb;
   int rc = -1;
 
   if (!nserv)
@@ -460,17 +776,29 @@ int nntp_newsrc_update(struct NntpServer *nserv)
   }
   buf[off] = '\0';
 
+  /* don't touch .newsrc if nothing has changed since it was read or written */
+  md5_buffer(buf, off, digest);
+  if (nserv->newsrc_file && memcmp(digest, nserv->newsrc_digest, sizeof(digest)) == 0 &&
+      stat(nserv->newsrc_file, &sb) == 0 && sb.st_size == nserv->size &&
+      sb.st_mtime == nserv->mtime)
+  {
+    mutt_debug(1, "%s is up to date\n", nserv->newsrc_file);
+    FREE(&buf);
+    return 0;
+  }
+
   /* newrc being fully rewritten */
   mutt_debug(1, "Updating %s\n", nserv->newsrc_file);
-  if (nserv->newsrc_file && update_file(nserv->newsrc_file, buf) == 0)
+  if (nserv->newsrc_file && update_file(nserv->newsrc_file, buf, off) == 0)
   {
-    struct stat sb;
-
     rc = stat(nserv->newsrc_file, &sb);
     if (rc == 0)
     {
       nserv->size = sb.st_size;
       nserv->mtime = sb.st_mtime;
+      memcpy(nserv->newsrc_digest, digest, sizeof(digest));
+      if (nserv->cacheable)
+        newsrc_save_cache(nserv, &sb);
     }
     else
     {
@@ -482,33 +810,6 @@ int nntp_newsrc_update(struct NntpServer *nserv)
   return rc;
 }
 
-/* Make fully qualified cache file name */
-static void cache_expand(char *dst, size_t dstlen, struct Account *acct, char *src)
-{
-  char *c = NULL;
-  char file[_POSIX_PATH_MAX];
-
-  /* server subdirectory */
-  if (acct)
-  {
-    struct CissUrl url;
-
-    mutt_account_tourl(acct, &url);
-    url.path = src;
-    url_ciss_tostring(&url, file, sizeof(file), U_PATH);
-  }
-  else
-    strfcpy(file, src ? src : "", sizeof(file));
-
-  snprintf(dst, dstlen, "%s/%s", NewsCacheDir, file);
-
-  /* remove trailing slash */
-  c = dst + strlen(dst) - 1;
-  if (*c == '/')
-    *c = '\0';
-  mutt_expand_path(dst, dstlen);
-}
-
 /* Make fully qualified url from newsgroup name */
 void nntp_expand_path(char *line, size_t len, struct Account *acct)
 {
@@ -520,11 +821,29 @@ void nntp_expand_path(char *line, size_t len, struct Account *acct)
   FREE(&url.path);
 }
 
+/* Add newsgroup from the list of newsgroups */
+static void active_add_group(struct NntpServer *nserv, const char *group, anum_t first,
+                             anum_t last, bool allowed, const char *desc)
+{
+  struct NntpData *nntp_data = nntp_data_find(nserv, group);
+
+  nntp_data->deleted = false;
+  nntp_data->firstMessage = first;
+  nntp_data->lastMessage = last;
+  nntp_data->allowed = allowed;
+  mutt_str_replace(&nntp_data->desc, desc);
+  if (nntp_data->newsrc_ent || nntp_data->lastCached)
+    nntp_group_unread_stat(nntp_data);
+  else if (nntp_data->lastMessage && nntp_data->firstMessage <= nntp_data->lastMessage)
+    nntp_data->unread = nntp_data->lastMessage - nntp_data->firstMessage + 1;
+  else
+    nntp_data->unread = 0;
+}
+
 /* Parse newsgroup */
 int nntp_add_group(char *line, void *data)
 {
   struct NntpServer *nserv = data;
-  struct NntpData *nntp_data = NULL;
   char group[LONG_STRING];
   char desc[HUGE_STRING] = "";
   char mod;
@@ -536,23 +855,12 @@ int nntp_add_group(char *line, void *data)
   if (sscanf(line, "%s " ANUM " " ANUM " %c %[^\n]", group, &last, &first, &mod, desc) < 4)
     return 0;
 
-  nntp_data = nntp_data_find(nserv, group);
-  nntp_data->deleted = false;
-  nntp_data->firstMessage = first;
-  nntp_data->lastMessage = last;
-  nntp_data->allowed = (mod == 'y') || (mod == 'm');
-  mutt_str_replace(&nntp_data->desc, desc);
-  if (nntp_data->newsrc_ent || nntp_data->lastCached)
-    nntp_group_unread_stat(nntp_data);
-  else if (nntp_data->lastMessage && nntp_data->firstMessage <= nntp_data->lastMessage)
-    nntp_data->unread = nntp_data->lastMessage - nntp_data->firstMessage + 1;
-  else
-    nntp_data->unread = 0;
+  active_add_group(nserv, group, first, last, (mod == 'y') || (mod == 'm'), desc);
   return 0;
 }
 
-/* Load list of all newsgroups from cache */
-static int active_get_cache(struct NntpServer *nserv)
+/* Load list of all newsgroups from the textual cache of older versions */
+static int active_get_text_cache(struct NntpServer *nserv)
 {
   char buf[HUGE_STRING];
   char file[_POSIX_PATH_MAX];
@@ -581,22 +889,78 @@ static int active_get_cache(struct NntpServer *nserv)
   return 0;
 }
 
+/* Load list of all newsgroups from cache */
+static int active_get_cache(struct NntpServer *nserv)
+{
+  struct NntpCacheHeader hdr;
+  struct NntpCacheMap map;
+  char file[_POSIX_PATH_MAX];
+  void *data = NULL;
+  size_t len;
+
+  cache_expand(file, sizeof(file), &nserv->conn->account, ".active.bin");
+  mutt_debug(1, "Loading %s\n", file);
+  data = cache_map(file, NNTP_ACTIVE_MAGIC, &hdr, &len);
+  if (!data)
+    return active_get_text_cache(nserv);
+  if (hdr.mtime == 0)
+  {
+    munmap(data, len);
+    return -1;
+  }
+
+  mutt_message(_("Loading list of groups from cache..."));
+
+  /* check the records before touching any newsgroup */
+  for (int apply = 0; apply < 2; apply++)
+  {
+    map.p = (unsigned char *) data + sizeof(hdr);
+    map.end = (unsigned char *) data + len;
+    map.error = false;
+
+    for (uint32_t i = 0; i < hdr.count && !map.error; i++)
+    {
+      const char *group = cache_get_str(&map);
+      anum_t last = cache_get_num(&map);
+      anum_t first = cache_get_num(&map);
+      bool allowed = cache_get_num(&map);
+      const char *desc = cache_get_str(&map);
+
+      if (apply && !map.error)
+        active_add_group(nserv, group, first, last, allowed, desc);
+    }
+    if (map.error || map.p != map.end)
+    {
+      mutt_debug(1, "active_get_cache: %s is corrupted\n", file);
+      munmap(data, len);
+      mutt_clear_error();
+      return -1;
+    }
+  }
+
+  nserv->newgroups_time = hdr.mtime;
+  munmap(data, len);
+  mutt_clear_error();
+  return 0;
+}
+
 /* Save list of all newsgroups to cache */
 int nntp_active_save_cache(struct NntpServer *nserv)
 {
+  struct NntpCacheHeader hdr;
+  struct NntpCacheBuf buf;
   char file[_POSIX_PATH_MAX];
-  char *buf = NULL;
-  size_t buflen, off;
   int rc;
 
   if (!nserv->cacheable)
     return 0;
 
-  buflen = 10 * LONG_STRING;
-  buf = safe_calloc(1, buflen);
-  snprintf(buf, buflen, "%lu\n", (unsigned long) nserv->newgroups_time);
-  off = strlen(buf);
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.magic, NNTP_ACTIVE_MAGIC, sizeof(hdr.magic));
+  hdr.mtime = nserv->newgroups_time;
 
+  memset(&buf, 0, sizeof(buf));
+  cache_put(&buf, &hdr, sizeof(hdr));
   for (unsigned int i = 0; i < nserv->groups_num; i++)
   {
     struct NntpData *nntp_data = nserv->groups_list[i];
@@ -604,22 +968,27 @@ int nntp_active_save_cache(struct NntpServer *nserv)
     if (!nntp_data || nntp_data->deleted)
       continue;
 
-    if (off + strlen(nntp_data->group) + (nntp_data->desc ? strlen(nntp_data->desc) : 0) + 50 > buflen)
-    {
-      buflen *= 2;
-      safe_realloc(&buf, buflen);
-    }
-    snprintf(buf + off, buflen - off, "%s %d %d %c%s%s\n", nntp_data->group,
-             nntp_data->lastMessage, nntp_data->firstMessage,
-             nntp_data->allowed ? 'y' : 'n', nntp_data->desc ? " " : "",
-             nntp_data->desc ? nntp_data->desc : "");
-    off += strlen(buf + off);
+    cache_put_str(&buf, nntp_data->group);
+    cache_put_num(&buf, nntp_data->lastMessage);
+    cache_put_num(&buf, nntp_data->firstMessage);
+    cache_put_num(&buf, nntp_data->allowed);
+    cache_put_str(&buf, nntp_data->desc);
+    hdr.count++;
   }
+  hdr.len = buf.len - sizeof(hdr);
+  memcpy(buf.data, &hdr, sizeof(hdr));
 
-  cache_expand(file, sizeof(file), &nserv->conn->account, ".active");
+  cache_expand(file, sizeof(file), &nserv->conn->account, ".active.bin");
   mutt_debug(1, "Updating %s\n", file);
-  rc = update_file(file, buf);
-  FREE(&buf);
+  rc = update_file(file, buf.data, buf.len);
+  FREE(&buf.data);
+
+  /* the textual cache is superseded */
+  if (rc == 0)
+  {
+    cache_expand(file, sizeof(file), &nserv->conn->account, ".active");
+    unlink(file);
+  }
   return rc;
 }
 
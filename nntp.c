@@ -796,6 +796,63 @@ static int nntp_query(struct NntpData *nntp_data, char *line, size_t linelen)
   return 0;
 }
 
+/* Read the lines of a multi-line response up to the terminating ".",
+ * calling funct(*line, *data) for each of them:
+ *  0 - success
+ * -1 - connection lost
+ * -2 - error in funct(*line, *data) */
+static int nntp_read_lines(struct NntpData *nntp_data, struct Progress *progress,
+                           int (*funct)(char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  char *line = NULL;
+  unsigned int lines = 0;
+  size_t off = 0;
+  int rc = 0;
+
+  line = safe_malloc(sizeof(buf));
+
+  while (1)
+  {
+    char *p = NULL;
+    int chunk = mutt_socket_readln_d(buf, sizeof(buf), nntp_data->nserv->conn,
+                                     MUTT_SOCK_LOG_HDR);
+    if (chunk < 0)
+    {
+      nntp_data->nserv->status = NNTP_NONE;
+      rc = -1;
+      break;
+    }
+
+    p = buf;
+    if (!off && buf[0] == '.')
+    {
+      if (buf[1] == '\0')
+        break;
+      if (buf[1] == '.')
+        p++;
+    }
+
+    strfcpy(line + off, p, sizeof(buf));
+
+    if (chunk >= sizeof(buf))
+      off += strlen(p);
+    else
+    {
+      if (progress)
+        mutt_progress_update(progress, ++lines, -1);
+
+      if (rc == 0 && funct(line, data) < 0)
+        rc = -2;
+      off = 0;
+    }
+
+    safe_realloc(&line, off + sizeof(buf));
+  }
+  FREE(&line);
+  return rc;
+}
+
 /* This function calls funct(*line, *data) for each received line,
  * funct(NULL, *data) if rewind(*data) needs, exits when fail or done:
  *  0 - success
@@ -805,15 +862,11 @@ static int nntp_query(struct NntpData *nntp_data, char *line, size_t linelen)
 static int nntp_fetch_lines(struct NntpData *nntp_data, char *query, size_t qlen,
                             char *msg, int (*funct)(char *, void *), void *data)
 {
-  int done = false;
   int rc;
 
-  while (!done)
+  while (1)
   {
     char buf[LONG_STRING];
-    char *line = NULL;
-    unsigned int lines = 0;
-    size_t off = 0;
     struct Progress progress;
 
     if (msg)
@@ -828,51 +881,34 @@ static int nntp_fetch_lines(struct NntpData *nntp_data, char *query, size_t qlen
       return 1;
     }
 
-    line = safe_malloc(sizeof(buf));
-    rc = 0;
-
-    while (1)
-    {
-      char *p = NULL;
-      int chunk = mutt_socket_readln_d(buf, sizeof(buf), nntp_data->nserv->conn,
-                                       MUTT_SOCK_LOG_HDR);
-      if (chunk < 0)
-      {
-        nntp_data->nserv->status = NNTP_NONE;
-        break;
-      }
-
-      p = buf;
-      if (!off && buf[0] == '.')
-      {
-        if (buf[1] == '\0')
-        {
-          done = true;
-          break;
-        }
-        if (buf[1] == '.')
-          p++;
-      }
-
-      strfcpy(line + off, p, sizeof(buf));
+    rc = nntp_read_lines(nntp_data, msg ? &progress : NULL, funct, data);
+    funct(NULL, data);
 
-      if (chunk >= sizeof(buf))
-        off += strlen(p);
-      else
-      {
-        if (msg)
-          mutt_progress_update(&progress, ++lines, -1);
+    /* query again once nntp_query() has reconnected */
+    if (rc != -1)
+      break;
+  }
+  return rc;
+}
 
-        if (rc == 0 && funct(line, data) < 0)
-          rc = -2;
-        off = 0;
-      }
+/* Read the response to a command that was sent with mutt_socket_write()
+ * while others were still outstanding.  Return codes are those of
+ * nntp_fetch_lines(), except that the connection isn't reestablished. */
+static int nntp_read_reply(struct NntpData *nntp_data, char *buf, size_t buflen,
+                           int (*funct)(char *, void *), void *data)
+{
+  int rc;
 
-      safe_realloc(&line, off + sizeof(buf));
-    }
-    FREE(&line);
-    funct(NULL, data);
+  if (mutt_socket_readln(buf, buflen, nntp_data->nserv->conn) < 0)
+  {
+    nntp_data->nserv->status = NNTP_NONE;
+    return -1;
   }
+  if (buf[0] != '2')
+    return 1;
+
+  rc = nntp_read_lines(nntp_data, NULL, funct, data);
+  funct(NULL, data);
   return rc;
 }
 
@@ -993,8 +1029,72 @@ struct FetchCtx
 #ifdef USE_HCACHE
   header_cache_t *hc;
 #endif
+  anum_t heads[NNTP_PIPELINE_DEPTH]; /* HEAD commands in flight */
+  int head_first;
+  int head_count;
+  anum_t head_next; /* next article to request */
 };
 
+/* Throw away a response nobody waits for any more */
+static int fetch_discard(char *line, void *data)
+{
+  return 0;
+}
+
+/* Send HEAD for current and the following articles that will have to be
+ * fetched from the server, keeping up to NNTP_PIPELINE_DEPTH in flight */
+static void nntp_send_heads(struct NntpData *nntp_data, struct FetchCtx *fc, anum_t current)
+{
+  char buf[SHORT_STRING];
+#ifdef USE_HCACHE
+  void *hdata = NULL;
+#endif
+
+  if (fc->head_next < current)
+    fc->head_next = current;
+
+  while (nntp_data->nserv->status == NNTP_OK &&
+         fc->head_count < NNTP_PIPELINE_DEPTH && fc->head_next <= fc->last)
+  {
+    anum_t anum = fc->head_next++;
+
+    if (!fc->messages[anum - fc->first])
+      continue;
+
+#ifdef USE_HCACHE
+    /* the caller has already looked up current */
+    snprintf(buf, sizeof(buf), "%d", anum);
+    if (anum != current && (hdata = mutt_hcache_fetch(fc->hc, buf, strlen(buf))))
+    {
+      mutt_hcache_free(fc->hc, &hdata);
+      continue;
+    }
+#endif
+
+    snprintf(buf, sizeof(buf), "HEAD %d\r\n", anum);
+    if (mutt_socket_write(nntp_data->nserv->conn, buf) < 0)
+    {
+      nntp_data->nserv->status = NNTP_NONE;
+      break;
+    }
+    fc->heads[(fc->head_first + fc->head_count++) % NNTP_PIPELINE_DEPTH] = anum;
+  }
+}
+
+/* Read and drop the responses to HEAD commands still in flight */
+static void nntp_drain_heads(struct NntpData *nntp_data, struct FetchCtx *fc)
+{
+  char buf[LONG_STRING];
+
+  for (; fc->head_count > 0; fc->head_count--)
+    if (nntp_read_reply(nntp_data, buf, sizeof(buf), fetch_discard, NULL) < 0 &&
+        nntp_data->nserv->status != NNTP_OK)
+      break;
+
+  fc->head_count = 0;
+  fc->head_first = 0;
+}
+
 /* Parse article number */
 static int fetch_numbers(char *line, void *data)
 {
@@ -1191,6 +1291,9 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
 #ifdef USE_HCACHE
   fc.hc = hc;
 #endif
+  fc.head_first = 0;
+  fc.head_count = 0;
+  fc.head_next = first;
 
   /* fetch list of articles */
   if (option(OPTLISTGROUP) && nntp_data->nserv->hasLISTGROUP && !nntp_data->deleted)
@@ -1312,8 +1415,34 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
         break;
       }
 
-      snprintf(buf, sizeof(buf), "HEAD %d\r\n", current);
-      rc = nntp_fetch_lines(nntp_data, buf, sizeof(buf), NULL, fetch_tempfile, fp);
+      /* HEAD has to be used for every article, so request the
+       * following ones before waiting for this one */
+      nntp_send_heads(nntp_data, &fc, current);
+      if (fc.head_count && fc.heads[fc.head_first] == current)
+      {
+        fc.head_first = (fc.head_first + 1) % NNTP_PIPELINE_DEPTH;
+        fc.head_count--;
+        rc = nntp_read_reply(nntp_data, buf, sizeof(buf), fetch_tempfile, fp);
+        if (rc == -1)
+        {
+          /* the other responses are gone with the connection */
+          fc.head_count = 0;
+          fc.head_next = current + 1;
+          rewind(fp);
+          if (ftruncate(fileno(fp), 0) < 0)
+            mutt_debug(1, "nntp_fetch_headers: can't truncate %s\n", tempfile);
+        }
+      }
+      else
+      {
+        nntp_drain_heads(nntp_data, &fc);
+        rc = -1;
+      }
+      if (rc == -1)
+      {
+        snprintf(buf, sizeof(buf), "HEAD %d\r\n", current);
+        rc = nntp_fetch_lines(nntp_data, buf, sizeof(buf), NULL, fetch_tempfile, fp);
+      }
       if (rc)
       {
         safe_fclose(&fp);
@@ -1368,6 +1497,8 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
     first_over = current + 1;
   }
 
+  nntp_drain_heads(nntp_data, &fc);
+
   if (!option(OPTLISTGROUP) || !nntp_data->nserv->hasLISTGROUP)
     current = first_over;
 
@@ -1729,18 +1860,13 @@ int nntp_post(const char *msg)
   return 0;
 }
 
-/* Check newsgroup for new articles:
+/* Update newsgroup from the response to GROUP command:
  *  1 - new articles found
- *  0 - no change
- * -1 - lost connection */
-static int nntp_group_poll(struct NntpData *nntp_data, int update_stat)
+ *  0 - no change */
+static int nntp_group_update(struct NntpData *nntp_data, char *buf, int update_stat)
 {
-  char buf[LONG_STRING] = "";
   anum_t count, first, last;
 
-  /* use GROUP command to poll newsgroup */
-  if (nntp_query(nntp_data, buf, sizeof(buf)) < 0)
-    return -1;
   if (sscanf(buf, "211 " ANUM " " ANUM " " ANUM, &count, &first, &last) != 3)
     return 0;
   if (first == nntp_data->firstMessage && last == nntp_data->lastMessage)
@@ -1771,6 +1897,20 @@ static int nntp_group_poll(struct NntpData *nntp_data, int update_stat)
   return 1;
 }
 
+/* Check newsgroup for new articles:
+ *  1 - new articles found
+ *  0 - no change
+ * -1 - lost connection */
+static int nntp_group_poll(struct NntpData *nntp_data, int update_stat)
+{
+  char buf[LONG_STRING] = "";
+
+  /* use GROUP command to poll newsgroup */
+  if (nntp_query(nntp_data, buf, sizeof(buf)) < 0)
+    return -1;
+  return nntp_group_update(nntp_data, buf, update_stat);
+}
+
 /* Check current newsgroup for new articles:
  *  MUTT_REOPENED       - articles have been renumbered or removed from server
  *  MUTT_NEW_MAIL       - new articles found
@@ -2155,7 +2295,7 @@ int nntp_check_new_groups(struct NntpServer *nserv)
   struct tm *tm = NULL;
   char buf[LONG_STRING];
   char *msg = (_("Checking for new newsgroups..."));
-  unsigned int i;
+  unsigned int i, j;
   int rc, update_active = false;
 
   if (!nserv || !nserv->newgroups_time)
@@ -2165,13 +2305,42 @@ int nntp_check_new_groups(struct NntpServer *nserv)
   if (option(OPTSHOWNEWNEWS))
   {
     mutt_message(_("Checking for new messages..."));
-    for (i = 0; i < nserv->groups_num; i++)
+    for (i = 0; i < nserv->groups_num;)
     {
-      struct NntpData *data = nserv->groups_list[i];
+      struct NntpData *window[NNTP_PIPELINE_DEPTH];
+      unsigned int count = 0, sent = 0;
 
-      if (data && data->subscribed)
+      /* send GROUP commands for a window of newsgroups at once */
+      for (; i < nserv->groups_num && count < NNTP_PIPELINE_DEPTH; i++)
       {
-        rc = nntp_group_poll(data, 1);
+        struct NntpData *data = nserv->groups_list[i];
+
+        if (!data || !data->subscribed)
+          continue;
+
+        window[count++] = data;
+        if (nserv->status != NNTP_OK)
+          continue;
+        snprintf(buf, sizeof(buf), "GROUP %s\r\n", data->group);
+        if (mutt_socket_write(nserv->conn, buf) < 0)
+          nserv->status = NNTP_NONE;
+        else
+          sent++;
+      }
+
+      /* collect the responses, polling one by one after reconnection */
+      for (j = 0; j < count; j++)
+      {
+        if (j < sent && mutt_socket_readln(buf, sizeof(buf), nserv->conn) < 0)
+        {
+          /* the remaining responses are lost with the connection */
+          nserv->status = NNTP_NONE;
+          sent = j;
+        }
+        if (j < sent)
+          rc = nntp_group_update(window[j], buf, 1);
+        else
+          rc = nntp_group_poll(window[j], 1);
         if (rc < 0)
           return -1;
         if (rc > 0)
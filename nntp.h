@@ -42,6 +42,9 @@ struct Context;
 /* number of entries in article cache */
 #define NNTP_ACACHE_LEN 10
 
+/* number of commands kept in flight when pipelining (RFC3977 3.5) */
+#define NNTP_PIPELINE_DEPTH 32
+
 /* article number type and format */
 #define anum_t uint32_t
 #define ANUM "%u"
@@ -74,6 +77,7 @@ struct NntpServer
   char *overview_fmt;
   off_t size;
   time_t mtime;
+  unsigned char newsrc_digest[16];
   time_t newgroups_time;
   time_t check_time;
   unsigned int groups_num;
@@ -40,6 +40,7 @@ enum
   OPTCHECKNEW,
   OPTCOLLAPSEALL,
   OPTCOLLAPSEUNREAD,
+  OPTCOMPRESSBUILTIN,
   OPTCONFIRMAPPEND,
   OPTCONFIRMCREATE,
   OPTDELETEUNTAG,
@@ -80,9 +81,11 @@ enum
   OPTIMAPCHECKSUBSCRIBED,
   OPTIMAPIDLE,
   OPTIMAPLSUB,
+  OPTIMAPNOTIFY,
   OPTIMAPPASSIVE,
   OPTIMAPPEEK,
   OPTIMAPSERVERNOISE,
+  OPTIMAPSERVERSORT,
 #endif
 #ifdef USE_SSL
 #ifndef USE_SSL_GNUTLS
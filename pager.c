@@ -731,13 +731,111 @@ static int check_attachment_marker(char *p)
   return (int) (*p - *q);
 }
 
+/**
+ * resolve_chunks - Find the parts of a line coloured by a list of patterns
+ * @lineInfo: Line info array
+ * @n:        Line number
+ * @buf:      Text of the line, without the line ending
+ * @list:     Colour patterns
+ *
+ * The line is split into chunks, left to right.  Each chunk is the leftmost
+ * match of any pattern (the longest, if several start at the same place),
+ * and the search continues after it.
+ *
+ * Rather than running every pattern again for every chunk, each pattern's
+ * next match is remembered and the pattern is only run again once the
+ * search has passed it.  Patterns that look at the text before a match, e.g.
+ * word boundaries, are always run again, as their match may depend on where
+ * the search starts.
+ */
+static void resolve_chunks(struct Line *lineInfo, int n, char *buf, struct ColorLine *list)
+{
+  struct ColorLine *color_line = NULL;
+  regmatch_t pmatch[1];
+  regmatch_t *next = NULL; /* next match of each pattern, rm_so -1 if none */
+  int found, offset, null_rx, count = 0, i = 0, j;
+
+  lineInfo[n].chunks = 0;
+  if (!list || !buf[0])
+    return;
+
+  for (color_line = list; color_line; color_line = color_line->next)
+    count++;
+  next = safe_malloc(count * sizeof(regmatch_t));
+  for (j = 0; j < count; j++)
+    next[j].rm_so = next[j].rm_eo = -2; /* not run yet */
+
+  offset = 0;
+  do
+  {
+    if (!buf[offset])
+      break;
+
+    found = 0;
+    null_rx = 0;
+    for (color_line = list, j = 0; color_line; color_line = color_line->next, j++)
+    {
+      if ((next[j].rm_so == -2) || (next[j].rm_so >= 0 && next[j].rm_so < offset) ||
+          color_line->uses_context)
+      {
+        if (regexec(&color_line->rx, buf + offset, 1, pmatch, (offset ? REG_NOTBOL : 0)) == 0)
+        {
+          next[j].rm_so = pmatch[0].rm_so + offset;
+          next[j].rm_eo = pmatch[0].rm_eo + offset;
+        }
+        else
+          next[j].rm_so = -1;
+      }
+
+      if (next[j].rm_so < 0)
+        continue;
+
+      if (next[j].rm_eo != next[j].rm_so)
+      {
+        if (!found)
+        {
+          /* Abort if we fill up chunks.
+           * Yes, this really happened. See #3888 */
+          if (lineInfo[n].chunks == SHRT_MAX)
+          {
+            null_rx = 0;
+            break;
+          }
+          if (++(lineInfo[n].chunks) > 1)
+            safe_realloc(&(lineInfo[n].syntax), (lineInfo[n].chunks) * sizeof(struct Syntax));
+        }
+        i = lineInfo[n].chunks - 1;
+        if (!found || next[j].rm_so < (lineInfo[n].syntax)[i].first ||
+            (next[j].rm_so == (lineInfo[n].syntax)[i].first &&
+             next[j].rm_eo > (lineInfo[n].syntax)[i].last))
+        {
+          (lineInfo[n].syntax)[i].color = color_line->pair;
+          (lineInfo[n].syntax)[i].first = next[j].rm_so;
+          (lineInfo[n].syntax)[i].last = next[j].rm_eo;
+        }
+        found = 1;
+        null_rx = 0;
+      }
+      else
+        null_rx = 1; /* empty regexp; don't add it, but keep looking */
+    }
+
+    if (null_rx)
+      offset++; /* avoid degenerate cases */
+    else
+      offset = (lineInfo[n].syntax)[i].last;
+  } while (found || null_rx);
+
+  FREE(&next);
+}
+
 static void resolve_types(char *buf, char *raw, struct Line *lineInfo, int n,
                           int last, struct QClass **QuoteList, int *q_level,
                           int *force_redraw, int q_classify)
 {
   struct ColorLine *color_line = NULL;
   regmatch_t pmatch[1], smatch[1];
-  int found, offset, null_rx, i;
+  int i;
 
   if (n == 0 || ISHEADER(lineInfo[n - 1].type))
   {
@@ -874,64 +972,10 @@ static void resolve_types(char *buf, char *raw, struct Line *lineInfo, int n,
     if ((nl = mutt_strlen(buf)) > 0 && buf[nl - 1] == '\n')
       buf[nl - 1] = 0;
 
-    i = 0;
-    offset = 0;
-    lineInfo[n].chunks = 0;
-    do
-    {
-      if (!buf[offset])
-        break;
-
-      found = 0;
-      null_rx = 0;
-      if (lineInfo[n].type == MT_COLOR_HDEFAULT)
-        color_line = ColorHdrList;
-      else
-        color_line = ColorBodyList;
-      while (color_line)
-      {
-        if (regexec(&color_line->rx, buf + offset, 1, pmatch, (offset ? REG_NOTBOL : 0)) == 0)
-        {
-          if (pmatch[0].rm_eo != pmatch[0].rm_so)
-          {
-            if (!found)
-            {
-              /* Abort if we fill up chunks.
-               * Yes, this really happened. See #3888 */
-              if (lineInfo[n].chunks == SHRT_MAX)
-              {
-                null_rx = 0;
-                break;
-              }
-              if (++(lineInfo[n].chunks) > 1)
-                safe_realloc(&(lineInfo[n].syntax),
-                             (lineInfo[n].chunks) * sizeof(struct Syntax));
-            }
-            i = lineInfo[n].chunks - 1;
-            pmatch[0].rm_so += offset;
-            pmatch[0].rm_eo += offset;
-            if (!found || pmatch[0].rm_so < (lineInfo[n].syntax)[i].first ||
-                (pmatch[0].rm_so == (lineInfo[n].syntax)[i].first &&
-                 pmatch[0].rm_eo > (lineInfo[n].syntax)[i].last))
-            {
-              (lineInfo[n].syntax)[i].color = color_line->pair;
-              (lineInfo[n].syntax)[i].first = pmatch[0].rm_so;
-              (lineInfo[n].syntax)[i].last = pmatch[0].rm_eo;
-            }
-            found = 1;
-            null_rx = 0;
-          }
-          else
-            null_rx = 1; /* empty regexp; don't add it, but keep looking */
-        }
-        color_line = color_line->next;
-      }
-
-      if (null_rx)
-        offset++; /* avoid degenerate cases */
-      else
-        offset = (lineInfo[n].syntax)[i].last;
-    } while (found || null_rx);
+    if (lineInfo[n].type == MT_COLOR_HDEFAULT)
+      resolve_chunks(lineInfo, n, buf, ColorHdrList);
+    else
+      resolve_chunks(lineInfo, n, buf, ColorBodyList);
     if (nl > 0)
       buf[nl] = '\n';
   }
@@ -946,52 +990,7 @@ static void resolve_types(char *buf, char *raw, struct Line *lineInfo, int n,
     if ((nl > 0) && (buf[nl - 1] == '\n'))
       buf[nl - 1] = 0;
 
-    i = 0;
-    offset = 0;
-    lineInfo[n].chunks = 0;
-    do
-    {
-      if (!buf[offset])
-        break;
-
-      found = 0;
-      null_rx = 0;
-      for (color_line = ColorAttachList; color_line; color_line = color_line->next)
-      {
-        if (regexec(&color_line->rx, buf + offset, 1, pmatch, (offset ? REG_NOTBOL : 0)) == 0)
-        {
-          if (pmatch[0].rm_eo != pmatch[0].rm_so)
-          {
-            if (!found)
-            {
-              if (++(lineInfo[n].chunks) > 1)
-                safe_realloc(&(lineInfo[n].syntax),
-                             (lineInfo[n].chunks) * sizeof(struct Syntax));
-            }
-            i = lineInfo[n].chunks - 1;
-            pmatch[0].rm_so += offset;
-            pmatch[0].rm_eo += offset;
-            if (!found || pmatch[0].rm_so < (lineInfo[n].syntax)[i].first ||
-                (pmatch[0].rm_so == (lineInfo[n].syntax)[i].first &&
-                 pmatch[0].rm_eo > (lineInfo[n].syntax)[i].last))
-            {
-              (lineInfo[n].syntax)[i].color = color_line->pair;
-              (lineInfo[n].syntax)[i].first = pmatch[0].rm_so;
-              (lineInfo[n].syntax)[i].last = pmatch[0].rm_eo;
-            }
-            found = 1;
-            null_rx = 0;
-          }
-          else
-            null_rx = 1; /* empty regexp; don't add it, but keep looking */
-        }
-      }
-
-      if (null_rx)
-        offset++; /* avoid degenerate cases */
-      else
-        offset = (lineInfo[n].syntax)[i].last;
-    } while (found || null_rx);
+    resolve_chunks(lineInfo, n, buf, ColorAttachList);
     if (nl > 0)
       buf[nl] = '\n';
   }
@@ -1788,7 +1787,7 @@ static void pager_menu_redraw(struct Menu *pager_menu)
 
       NORMAL_COLOR;
       rd->index->pagelen = rd->index_window->rows;
-      ;
+      menu_damage_all(rd->index); /* the screen has been cleared */
 
       /* some fudge to work out whereabouts the indicator should go */
       if (rd->index->current - rd->indicator < 0)
@@ -1959,6 +1958,62 @@ static void pager_menu_redraw(struct Menu *pager_menu)
   pager_menu->redraw = 0;
 }
 
+/* number of lines laid out between checks for a key press */
+#define PAGER_LAYOUT_CHUNK 256
+
+/**
+ * pager_layout_ahead - Lay out the rest of the message while waiting for a key
+ * @rd:         Pager data
+ * @pager_menu: Pager menu
+ *
+ * The lines below the screen are classified, coloured and wrapped, a chunk at
+ * a time, until a key is pressed or the end of the message is reached.  After
+ * that, jumping to the bottom, or searching, won't have to lay out every line
+ * on the way.
+ *
+ * This works like the IMAP prefetch in km_dokey().
+ *
+ * Returns:
+ *      true:  The screen must be redrawn
+ *      false: A key is waiting, or the whole message has been laid out
+ */
+static bool pager_layout_ahead(struct PagerRedrawData *rd, struct Menu *pager_menu)
+{
+  struct Event ev;
+
+  while (rd->lineInfo[rd->lastLine].offset < rd->sb.st_size)
+  {
+    timeout(0);
+    ev = mutt_getch();
+    timeout(-1);
+    if ((ev.ch != -2) || SigWinch)
+    {
+      /* let km_dokey() see the key, or the resize */
+      mutt_unget_event(ev.ch, ev.op);
+      return false;
+    }
+
+    for (int i = 0; i < PAGER_LAYOUT_CHUNK; i++)
+    {
+      if (display_line(rd->fp, &rd->last_pos, &rd->lineInfo, rd->lastLine,
+                       &rd->lastLine, &rd->maxLine,
+                       rd->has_types | rd->SearchFlag | (rd->flags & MUTT_PAGER_NOWRAP),
+                       &rd->QuoteList, &rd->q_level, &rd->force_redraw,
+                       &rd->SearchRE, rd->pager_window) != 0)
+        return false;
+    }
+
+    /* a line may have changed the colour of the lines above it */
+    if (rd->force_redraw)
+    {
+      pager_menu->redraw |= REDRAW_BODY;
+      return true;
+    }
+  }
+
+  return false;
+}
+
 /* This pager is actually not so simple as it once was.  It now operates in
    two modes: one for viewing messages and the other for viewing help.  These
    can be distinguished by whether or not ``hdr'' is NULL.  The ``hdr'' arg
@@ -2091,6 +2146,9 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
     else
       OldHdr = NULL;
 
+    if (pager_layout_ahead(&rd, pager_menu))
+      continue;
+
     ch = km_dokey(MENU_PAGER);
     if (ch != -1)
     {
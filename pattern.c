@@ -1653,6 +1653,66 @@ int mutt_pattern_exec(struct Pattern *pat, pattern_exec_flag flags,
   return -1;
 }
 
+/**
+ * mutt_pattern_is_static - Does a pattern only depend on a message's contents?
+ * @pat: Pattern to test
+ *
+ * A static pattern looks only at the envelope, body, dates and size of a
+ * message, which never change while it's in a mailbox.  Its result can be
+ * cached.  Patterns looking at flags, scores, labels, tags, threads or the
+ * config (lists, alternates, groups) are not static.  Neither are the
+ * crypto patterns, as h->security changes once a message has been checked
+ * or decrypted, nor ~X, which depends on the attachment counting rules.
+ *
+ * Returns: true if the pattern is static
+ */
+bool mutt_pattern_is_static(const struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    if (pat->groupmatch || pat->isalias)
+      return false;
+
+    switch (pat->op)
+    {
+      case MUTT_AND:
+      case MUTT_OR:
+        if (!mutt_pattern_is_static(pat->child))
+          return false;
+        break;
+      case MUTT_BODY:
+      case MUTT_HEADER:
+      case MUTT_WHOLE_MSG:
+        /* an IMAP string search is done by the server, see h->matched */
+        if (pat->stringmatch)
+          return false;
+        break;
+      case MUTT_ALL:
+      case MUTT_DATE:
+      case MUTT_DATE_RECEIVED:
+      case MUTT_SENDER:
+      case MUTT_FROM:
+      case MUTT_TO:
+      case MUTT_CC:
+      case MUTT_SUBJECT:
+      case MUTT_ID:
+      case MUTT_SIZE:
+      case MUTT_REFERENCE:
+      case MUTT_ADDRESS:
+      case MUTT_RECIPIENT:
+      case MUTT_HORMEL:
+#ifdef USE_NNTP
+      case MUTT_NEWSGROUPS:
+#endif
+        break;
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
 static void quote_simple(char *tmp, size_t len, const char *p)
 {
   int i = 0;
@@ -1765,6 +1825,7 @@ bool mutt_limit_current_thread(struct Header *h)
   Context->vcount = 0;
   Context->vsize = 0;
   Context->collapsed = false;
+  IndexGeneration++;
 
   for (int i = 0; i < Context->msgcount; i++)
   {
@@ -1831,6 +1892,7 @@ int mutt_pattern_func(int op, char *prompt)
     Context->vcount = 0;
     Context->vsize = 0;
     Context->collapsed = false;
+    IndexGeneration++;
 
     for (int i = 0; i < Context->msgcount; i++)
     {
@@ -79,6 +79,7 @@ int mutt_pattern_exec(struct Pattern *pat, pattern_exec_flag flags,
 struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer *err);
 void mutt_check_simple(char *s, size_t len, const char *simple);
 void mutt_pattern_free(struct Pattern **pat);
+bool mutt_pattern_is_static(const struct Pattern *pat);
 
 int mutt_which_case(const char *s);
 int mutt_is_list_recipient(int alladdr, struct Address *a1, struct Address *a2);
@@ -63,6 +63,41 @@ static int fetch_message(char *line, void *file)
   return 0;
 }
 
+/* parse the header written to f, length is the message size from LIST */
+static void pop_parse_header(struct Header *h, FILE *f, long length)
+{
+  char buf[LONG_STRING];
+
+  rewind(f);
+  h->env = mutt_read_rfc822_header(f, h, 0, 0);
+  h->content->length = length - h->content->offset + 1;
+  rewind(f);
+  while (!feof(f))
+  {
+    h->content->length--;
+    fgets(buf, sizeof(buf), f);
+  }
+}
+
+/* throw away the lines of an answer nobody waits for any more */
+static int fetch_discard(char *line, void *data)
+{
+  return 0;
+}
+
+/* parse LIST, sizes[0] holds the number of slots after it */
+static int fetch_list(char *line, void *data)
+{
+  long *sizes = (long *) data;
+  long length;
+  int index;
+
+  if (sscanf(line, "%d %ld", &index, &length) == 2 && index > 0 && index <= sizes[0])
+    sizes[index] = length;
+
+  return 0;
+}
+
 /*
  * Read header
  * returns:
@@ -119,15 +154,7 @@ static int pop_read_header(struct PopData *pop_data, struct Header *h)
   {
     case 0:
     {
-      rewind(f);
-      h->env = mutt_read_rfc822_header(f, h, 0, 0);
-      h->content->length = length - h->content->offset + 1;
-      rewind(f);
-      while (!feof(f))
-      {
-        h->content->length--;
-        fgets(buf, sizeof(buf), f);
-      }
+      pop_parse_header(h, f, length);
       break;
     }
     case -2:
@@ -147,6 +174,92 @@ static int pop_read_header(struct PopData *pop_data, struct Header *h)
   return ret;
 }
 
+/*
+ * Read the headers of count messages with PIPELINING: the sizes come from a
+ * single LIST and up to POP_PIPELINE_DEPTH TOP commands are kept in flight.
+ * *done is set to the number of headers read, in order.
+ * returns the same as pop_read_header()
+ */
+static int pop_read_headers(struct PopData *pop_data, struct Header **hdrs, int count,
+                            int maxrefno, struct Progress *progress, int *done)
+{
+  FILE *f = NULL;
+  long *sizes = NULL;
+  int ret, sent = 0, recv = 0;
+  char buf[LONG_STRING];
+  char tempfile[_POSIX_PATH_MAX];
+
+  *done = 0;
+
+  mutt_mktemp(tempfile, sizeof(tempfile));
+  if (!(f = safe_fopen(tempfile, "w+")))
+  {
+    mutt_perror(tempfile);
+    return -3;
+  }
+
+  sizes = safe_calloc(maxrefno + 1, sizeof(long));
+  sizes[0] = maxrefno;
+  ret = pop_fetch_data(pop_data, "LIST\r\n", NULL, fetch_list, sizes);
+
+  while (ret == 0 && recv < count)
+  {
+    for (; sent < count && sent - recv < POP_PIPELINE_DEPTH; sent++)
+    {
+      snprintf(buf, sizeof(buf), "TOP %d 0\r\n", hdrs[sent]->refno);
+      if ((ret = pop_send(pop_data, buf)) < 0)
+        break;
+    }
+    if (ret < 0)
+      break;
+
+    ret = pop_read_reply(pop_data, "TOP", NULL, fetch_message, f);
+    recv++;
+    if (ret == 0)
+    {
+      struct Header *h = hdrs[*done];
+
+      pop_parse_header(h, f, (h->refno > 0 && h->refno <= maxrefno) ? sizes[h->refno] : 0);
+      rewind(f);
+      if (ftruncate(fileno(f), 0) < 0)
+        ret = -3;
+      else
+        (*done)++;
+
+      if (progress)
+        mutt_progress_update(progress, *done, -1);
+    }
+  }
+
+  /* the answers to commands still in flight must be read before the
+   * connection can be used again */
+  while (ret != -1 && recv < sent)
+  {
+    if (pop_read_reply(pop_data, "TOP", NULL, fetch_discard, NULL) == -1)
+      ret = -1;
+    recv++;
+  }
+
+  switch (ret)
+  {
+    case -2:
+    {
+      mutt_error("%s", pop_data->err_msg);
+      break;
+    }
+    case -3:
+    {
+      mutt_error(_("Can't write header to temporary file!"));
+      break;
+    }
+  }
+
+  FREE(&sizes);
+  safe_fclose(&f);
+  unlink(tempfile);
+  return ret;
+}
+
 /* parse UIDL */
 static int fetch_uidl(char *line, void *data)
 {
@@ -245,8 +358,11 @@ static header_cache_t *pop_hcache_open(struct PopData *pop_data, const char *pat
  */
 static int pop_fetch_headers(struct Context *ctx)
 {
-  int i, ret, old_count, new_count, deleted;
-  unsigned short hcached = 0, bcached;
+  int i, k, ret, old_count, new_count, deleted;
+  int ntodo = 0, fetched = 0;
+  unsigned short bcached;
+  bool *hcached = NULL;
+  struct Header **todo = NULL;
   struct PopData *pop_data = (struct PopData *) ctx->data;
   struct Progress progress;
 
@@ -307,10 +423,12 @@ static int pop_fetch_headers(struct Context *ctx)
       mutt_sleep(2);
     }
 
+    /* restore what we can from the header cache first, so that the
+     * remaining headers can be requested together */
+    hcached = safe_calloc(new_count - old_count + 1, sizeof(bool));
+    todo = safe_calloc(new_count - old_count + 1, sizeof(struct Header *));
     for (i = old_count; i < new_count; i++)
     {
-      if (!ctx->quiet)
-        mutt_progress_update(&progress, i + 1 - old_count, -1);
 #ifdef USE_HCACHE
       if ((data = mutt_hcache_fetch(hc, ctx->hdrs[i]->data, strlen(ctx->hdrs[i]->data))))
       {
@@ -333,20 +451,42 @@ static int pop_fetch_headers(struct Context *ctx)
         ctx->hdrs[i]->refno = refno;
         ctx->hdrs[i]->index = index;
         ctx->hdrs[i]->data = uidl;
-        ret = 0;
-        hcached = 1;
+        hcached[i - old_count] = true;
+        continue;
       }
-      else
 #endif
-          if ((ret = pop_read_header(pop_data, ctx->hdrs[i])) < 0)
-        break;
-#ifdef USE_HCACHE
-      else
+      todo[ntodo++] = ctx->hdrs[i];
+    }
+
+    if (!ctx->quiet)
+      mutt_progress_update(&progress, new_count - old_count - ntodo, -1);
+
+    if (pop_data->cmd_pipe && ntodo > 1)
+      ret = pop_read_headers(pop_data, todo, ntodo, new_count,
+                             ctx->quiet ? NULL : &progress, &fetched);
+    else
+    {
+      for (fetched = 0; fetched < ntodo; fetched++)
       {
+        if ((ret = pop_read_header(pop_data, todo[fetched])) < 0)
+          break;
+        if (!ctx->quiet)
+          mutt_progress_update(&progress, new_count - old_count - ntodo + fetched + 1, -1);
+      }
+    }
+
+    for (i = old_count, k = 0; i < new_count; i++)
+    {
+      if (!hcached[i - old_count])
+      {
+        /* stop at the first header that couldn't be read */
+        if (k++ >= fetched)
+          break;
+#ifdef USE_HCACHE
         mutt_hcache_store(hc, ctx->hdrs[i]->data, strlen(ctx->hdrs[i]->data),
                           ctx->hdrs[i], 0);
-      }
 #endif
+      }
 
       /*
        * faked support for flags works like this:
@@ -363,7 +503,7 @@ static int pop_fetch_headers(struct Context *ctx)
       bcached = mutt_bcache_exists(pop_data->bcache, ctx->hdrs[i]->data) == 0;
       ctx->hdrs[i]->old = false;
       ctx->hdrs[i]->read = false;
-      if (hcached)
+      if (hcached[i - old_count])
       {
         if (bcached)
           ctx->hdrs[i]->read = true;
@@ -378,6 +518,8 @@ static int pop_fetch_headers(struct Context *ctx)
 
       ctx->msgcount++;
     }
+    FREE(&hcached);
+    FREE(&todo);
 
     if (i > old_count)
       mx_update_context(ctx, i - old_count);
@@ -627,6 +769,15 @@ static int pop_fetch_message(struct Context *ctx, struct Message *msg, int msgno
   /* Update the header information.  Previously, we only downloaded a
    * portion of the headers, those required for the main display.
    */
+  /* the body cache reads the file by name, so it must all be written out */
+  if (bcache && (fflush(msg->fp) != 0 || ferror(msg->fp)))
+  {
+    mutt_error(_("Can't write message to temporary file!"));
+    safe_fclose(&msg->fp);
+    mutt_sleep(2);
+    return -1;
+  }
+
   if (bcache)
     mutt_bcache_commit(pop_data->bcache, h->data);
   else
@@ -789,7 +940,9 @@ void pop_fetch_mail(void)
   char buffer[LONG_STRING];
   char msgbuf[SHORT_STRING];
   char *url = NULL, *p = NULL;
-  int delanswer, last = 0, msgs, bytes, rset = 0, ret;
+  int delanswer, last = 0, msgs, bytes, rset = 0, ret, rc, i;
+  int queue[POP_PIPELINE_DEPTH + 1];
+  int qhead = 0, qlen = 0, depth, next;
   struct Connection *conn = NULL;
   struct Context ctx;
   struct Message *msg = NULL;
@@ -875,50 +1028,82 @@ void pop_fetch_mail(void)
   snprintf(msgbuf, sizeof(msgbuf), _("Reading new messages (%d bytes)..."), bytes);
   mutt_message("%s", msgbuf);
 
-  for (int i = last + 1; i <= msgs; i++)
+  /* With PIPELINING the next RETRs are sent before the current message has
+   * arrived and DELE doesn't wait for its answer.  The queue holds the
+   * commands in flight in order: n for RETR n, -n for DELE n. */
+  depth = pop_data->cmd_pipe ? POP_PIPELINE_DEPTH : 1;
+  next = last + 1;
+  ret = 0;
+  while (true)
   {
-    if ((msg = mx_open_new_message(&ctx, NULL, MUTT_ADD_FROM)) == NULL)
-      ret = -3;
+    for (; ret == 0 && next <= msgs && qlen < depth; next++)
+    {
+      snprintf(buffer, sizeof(buffer), "RETR %d\r\n", next);
+      if ((ret = pop_send(pop_data, buffer)) == 0)
+        queue[(qhead + qlen++) % mutt_array_size(queue)] = next;
+    }
+    if (ret == -1 || qlen == 0)
+      break;
+
+    i = queue[qhead];
+    qhead = (qhead + 1) % mutt_array_size(queue);
+    qlen--;
+
+    if (i < 0)
+    {
+      rc = pop_read_reply(pop_data, "DELE", NULL, NULL, NULL);
+    }
+    else if (ret != 0)
+    {
+      /* something failed already, only drain what is still coming */
+      rc = pop_read_reply(pop_data, "RETR", NULL, fetch_discard, NULL);
+    }
+    else if ((msg = mx_open_new_message(&ctx, NULL, MUTT_ADD_FROM)) == NULL)
+    {
+      rc = pop_read_reply(pop_data, "RETR", NULL, fetch_discard, NULL);
+      if (rc != -1)
+        rc = -3;
+    }
     else
     {
-      snprintf(buffer, sizeof(buffer), "RETR %d\r\n", i);
-      ret = pop_fetch_data(pop_data, buffer, NULL, fetch_message, msg->fp);
-      if (ret == -3)
+      rc = pop_read_reply(pop_data, "RETR", NULL, fetch_message, msg->fp);
+      if (rc == -3)
         rset = 1;
 
-      if (ret == 0 && mx_commit_message(msg, &ctx) != 0)
+      if (rc == 0 && mx_commit_message(msg, &ctx) != 0)
       {
         rset = 1;
-        ret = -3;
+        rc = -3;
       }
 
       mx_close_message(&ctx, &msg);
-    }
 
-    if (ret == 0 && delanswer == MUTT_YES)
-    {
-      /* delete the message on the server */
-      snprintf(buffer, sizeof(buffer), "DELE %d\r\n", i);
-      ret = pop_query(pop_data, buffer, sizeof(buffer));
-    }
+      if (rc == 0 && delanswer == MUTT_YES)
+      {
+        /* delete the message on the server */
+        snprintf(buffer, sizeof(buffer), "DELE %d\r\n", i);
+        if ((rc = pop_send(pop_data, buffer)) == 0)
+          queue[(qhead + qlen++) % mutt_array_size(queue)] = -i;
+      }
 
-    if (ret == -1)
-    {
-      mx_close_mailbox(&ctx, NULL);
-      goto fail;
+      if (rc == 0)
+        mutt_message(_("%s [%d of %d messages read]"), msgbuf, i - last, msgs - last);
     }
-    if (ret == -2)
-    {
+
+    if (rc == 0 || (ret != 0 && rc != -1))
+      continue;
+    if (rc == -2 && ret == 0)
       mutt_error("%s", pop_data->err_msg);
-      break;
-    }
-    if (ret == -3)
-    {
+    if (rc == -3 && ret == 0)
       mutt_error(_("Error while writing mailbox!"));
-      break;
-    }
+    if (ret == 0 || rc == -1)
+      ret = rc;
+  }
 
-    mutt_message(_("%s [%d of %d messages read]"), msgbuf, i - last, msgs - last);
+  if (ret == -1)
+  {
+    mx_close_mailbox(&ctx, NULL);
+    goto fail;
   }
 
   mx_close_mailbox(&ctx, NULL);
@@ -35,6 +35,9 @@ struct Progress;
 /* maximal length of the server response (RFC1939) */
 #define POP_CMD_RESPONSE 512
 
+/* number of commands kept in flight with PIPELINING (RFC2449) */
+#define POP_PIPELINE_DEPTH 32
+
 enum
 {
   /* Status */
@@ -68,6 +71,7 @@ struct PopData
   unsigned int cmd_user : 2; /* optional command USER */
   unsigned int cmd_uidl : 2; /* optional command UIDL */
   unsigned int cmd_top : 2;  /* optional command TOP */
+  bool cmd_pipe : 1;         /* server supports PIPELINING */
   bool resp_codes : 1;       /* server supports extended response codes */
   bool expire : 1;           /* expire is greater than 0 */
   bool clear_cache : 1;
@@ -102,6 +106,9 @@ int pop_open_connection(struct PopData *pop_data);
 int pop_query_d(struct PopData *pop_data, char *buf, size_t buflen, char *msg);
 int pop_fetch_data(struct PopData *pop_data, char *query, struct Progress *progressbar,
                    int (*funct)(char *, void *), void *data);
+int pop_send(struct PopData *pop_data, const char *cmd);
+int pop_read_reply(struct PopData *pop_data, const char *cmd, struct Progress *progressbar,
+                   int (*funct)(char *, void *), void *data);
 int pop_reconnect(struct Context *ctx);
 void pop_logout(struct Context *ctx);
 
@@ -125,6 +125,9 @@ static int fetch_capa(char *line, void *data)
   else if (ascii_strncasecmp(line, "TOP", 3) == 0)
     pop_data->cmd_top = 1;
 
+  else if (ascii_strncasecmp(line, "PIPELINING", 10) == 0)
+    pop_data->cmd_pipe = true;
+
   return 0;
 }
 
@@ -170,6 +173,7 @@ static int pop_capabilities(struct PopData *pop_data, int mode)
     pop_data->cmd_user = 0;
     pop_data->cmd_uidl = 0;
     pop_data->cmd_top = 0;
+    pop_data->cmd_pipe = false;
     pop_data->resp_codes = false;
     pop_data->expire = true;
     pop_data->login_delay = 0;
@@ -417,6 +421,29 @@ void pop_logout(struct Context *ctx)
   return;
 }
 
+/*
+ * Read the status line answering cmd into buf
+ *  0 - successful,
+ * -1 - connection lost,
+ * -2 - invalid command or execution error.
+*/
+static int pop_read_status(struct PopData *pop_data, const char *cmd, char *buf, size_t buflen)
+{
+  snprintf(pop_data->err_msg, sizeof(pop_data->err_msg), "%.*s: ",
+           (int) strcspn(cmd, " \r\n"), cmd);
+
+  if (mutt_socket_readln(buf, buflen, pop_data->conn) < 0)
+  {
+    pop_data->status = POP_DISCONNECTED;
+    return -1;
+  }
+  if (mutt_strncmp(buf, "+OK", 3) == 0)
+    return 0;
+
+  pop_error(pop_data, buf);
+  return -2;
+}
+
 /*
  * Send data from buffer and receive answer to the same buffer
  *  0 - successful,
@@ -426,7 +453,6 @@ void pop_logout(struct Context *ctx)
 int pop_query_d(struct PopData *pop_data, char *buf, size_t buflen, char *msg)
 {
   int dbg = MUTT_SOCK_LOG_CMD;
-  char *c = NULL;
 
   if (pop_data->status != POP_CONNECTED)
     return -1;
@@ -442,47 +468,43 @@ int pop_query_d(struct PopData *pop_data, char *buf, size_t buflen, char *msg)
 
   mutt_socket_write_d(pop_data->conn, buf, -1, dbg);
 
-  c = strpbrk(buf, " \r\n");
-  if (c)
-    *c = '\0';
-  snprintf(pop_data->err_msg, sizeof(pop_data->err_msg), "%s: ", buf);
+  return pop_read_status(pop_data, buf, buf, buflen);
+}
 
-  if (mutt_socket_readln(buf, buflen, pop_data->conn) < 0)
+/*
+ * Send a command without waiting for the answer, which has to be read
+ * with pop_read_reply() later.  Only for servers announcing PIPELINING.
+ *  0 - successful,
+ * -1 - connection lost.
+*/
+int pop_send(struct PopData *pop_data, const char *cmd)
+{
+  if (pop_data->status != POP_CONNECTED)
+    return -1;
+
+  if (mutt_socket_write(pop_data->conn, cmd) < 0)
   {
     pop_data->status = POP_DISCONNECTED;
     return -1;
   }
-  if (mutt_strncmp(buf, "+OK", 3) == 0)
-    return 0;
 
-  pop_error(pop_data, buf);
-  return -2;
+  return 0;
 }
 
 /*
- * This function calls  funct(*line, *data)  for each received line,
- * funct(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
- * Returned codes:
- *  0 - successful,
- * -1 - connection lost,
- * -2 - invalid command or execution error,
- * -3 - error in funct(*line, *data)
+ * Read the lines of a multi-line answer up to the terminating ".",
+ * see pop_fetch_data()
  */
-int pop_fetch_data(struct PopData *pop_data, char *query, struct Progress *progressbar,
-                   int (*funct)(char *, void *), void *data)
+static int pop_read_data(struct PopData *pop_data, struct Progress *progressbar,
+                         int (*funct)(char *, void *), void *data)
 {
   char buf[LONG_STRING];
   char *inbuf = NULL;
   char *p = NULL;
-  int ret, chunk = 0;
+  int ret = 0, chunk = 0;
   long pos = 0;
   size_t lenbuf = 0;
 
-  strfcpy(buf, query, sizeof(buf));
-  ret = pop_query(pop_data, buf, sizeof(buf));
-  if (ret < 0)
-    return ret;
-
   inbuf = safe_malloc(sizeof(buf));
 
   while (true)
@@ -527,6 +549,48 @@ int pop_fetch_data(struct PopData *pop_data, char *query, struct Progress *progr
   return ret;
 }
 
+/*
+ * This function calls  funct(*line, *data)  for each received line,
+ * funct(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
+ * Returned codes:
+ *  0 - successful,
+ * -1 - connection lost,
+ * -2 - invalid command or execution error,
+ * -3 - error in funct(*line, *data)
+ */
+int pop_fetch_data(struct PopData *pop_data, char *query, struct Progress *progressbar,
+                   int (*funct)(char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  int ret;
+
+  strfcpy(buf, query, sizeof(buf));
+  ret = pop_query(pop_data, buf, sizeof(buf));
+  if (ret < 0)
+    return ret;
+
+  return pop_read_data(pop_data, progressbar, funct, data);
+}
+
+/*
+ * Read the answer to a command sent earlier with pop_send().  If funct is
+ * NULL the answer is a single status line, otherwise the data following it
+ * is handed to funct as in pop_fetch_data().  Returned codes are those of
+ * pop_fetch_data().
+ */
+int pop_read_reply(struct PopData *pop_data, const char *cmd, struct Progress *progressbar,
+                   int (*funct)(char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  int ret;
+
+  ret = pop_read_status(pop_data, cmd, buf, sizeof(buf));
+  if (ret < 0 || !funct)
+    return ret;
+
+  return pop_read_data(pop_data, progressbar, funct, data);
+}
+
 /* find message with this UIDL and set refno */
 static int check_uidl(char *line, void *data)
 {
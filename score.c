@@ -154,6 +154,7 @@ void mutt_score_message(struct Context *ctx, struct Header *hdr, int upd_ctx)
   }
   if (hdr->score < 0)
     hdr->score = 0;
+  FREE(&hdr->index_line);
 
   if (hdr->score <= ScoreThresholdDelete)
     _mutt_set_flag(ctx, hdr, MUTT_DELETE, 1, upd_ctx);
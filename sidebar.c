@@ -44,6 +44,9 @@
 /* Previous values for some sidebar config */
 static short PreviousSort = SORT_ORDER; /* sidebar_sort_method */
 
+/* Set when the Entries array has gained mailboxes that haven't been sorted */
+static bool EntriesUnsorted = true;
+
 /**
  * struct SbEntry - Info about folders in the sidebar
  */
@@ -52,6 +55,16 @@ struct SbEntry
   char box[STRING]; /* formatted mailbox name */
   struct Buffy *buffy;
   short is_hidden;
+  int sort_key; /* sort field as it was when the Entries were last sorted */
+
+  /* The entry as last formatted by make_sidebar_entry() and what it showed */
+  char display[STRING];
+  int display_width; /* 0 if the entry hasn't been formatted */
+  unsigned int display_gen;
+  int msg_count;
+  int msg_unread;
+  int msg_flagged;
+  bool new;
 };
 
 static int EntryCount = 0;
@@ -341,6 +354,26 @@ static int cb_qsort_sbe(const void *a, const void *b)
   return result;
 }
 
+/**
+ * sbe_sort_key - Get the Buffy count that an SbEntry is sorted by
+ * @sbe: SbEntry to look at
+ *
+ * Returns: the count for $sidebar_sort_method, or 0 if it sorts by name
+ */
+static int sbe_sort_key(const struct SbEntry *sbe)
+{
+  switch ((SidebarSortMethod & SORT_MASK))
+  {
+    case SORT_COUNT:
+      return sbe->buffy->msg_count;
+    case SORT_UNREAD:
+      return sbe->buffy->msg_unread;
+    case SORT_FLAGGED:
+      return sbe->buffy->msg_flagged;
+  }
+  return 0;
+}
+
 /**
  * update_entries_visibility - Should a sidebar_entry be displayed in the sidebar
  *
@@ -410,6 +443,26 @@ static void unsort_entries(void)
   }
 }
 
+/**
+ * resort_entries - Restore the order of a nearly sorted Entries array
+ *
+ * An insertion sort: it only moves the entries whose counts have changed, and
+ * like qsort, it keeps equal entries in their existing order.
+ */
+static void resort_entries(void)
+{
+  struct SbEntry *sbe = NULL;
+  int j;
+
+  for (int i = 1; i < EntryCount; i++)
+  {
+    sbe = Entries[i];
+    for (j = i; (j > 0) && (cb_qsort_sbe(&Entries[j - 1], &sbe) > 0); j--)
+      Entries[j] = Entries[j - 1];
+    Entries[j] = sbe;
+  }
+}
+
 /**
  * sort_entries - Sort Entries array.
  *
@@ -417,17 +470,39 @@ static void unsort_entries(void)
  * option "sidebar_sort_method". This calls qsort to do the work which calls our
  * callback function "cb_qsort_sbe".
  *
- * Once sorted, the prev/next links will be reconstructed.
+ * The array is kept between refreshes, so if neither the sort method nor any
+ * of the counts it uses have changed, it's still in order and there's nothing
+ * to do.  If only a few counts have changed, those entries are moved into
+ * place by resort_entries().
  */
 static void sort_entries(void)
 {
   short ssm = (SidebarSortMethod & SORT_MASK);
+  bool changed = false;
+  int key;
+
+  for (int i = 0; i < EntryCount; i++)
+  {
+    key = sbe_sort_key(Entries[i]);
+    if (key != Entries[i]->sort_key)
+    {
+      Entries[i]->sort_key = key;
+      changed = true;
+    }
+  }
 
   /* These are the only sort methods we understand */
   if ((ssm == SORT_COUNT) || (ssm == SORT_UNREAD) || (ssm == SORT_FLAGGED) || (ssm == SORT_PATH))
-    qsort(Entries, EntryCount, sizeof(*Entries), cb_qsort_sbe);
+  {
+    if (EntriesUnsorted || (SidebarSortMethod != PreviousSort))
+      qsort(Entries, EntryCount, sizeof(*Entries), cb_qsort_sbe);
+    else if (changed)
+      resort_entries();
+  }
   else if ((ssm == SORT_ORDER) && (SidebarSortMethod != PreviousSort))
     unsort_entries();
+
+  EntriesUnsorted = false;
 }
 
 /**
@@ -863,7 +938,9 @@ static void draw_sidebar(int num_rows, int num_cols, int div_width)
       col = div_width;
 
     mutt_window_move(MuttSidebarWindow, row, col);
-    if (Context && Context->realpath && (mutt_strcmp(b->realpath, Context->realpath) == 0))
+    bool is_open = Context && Context->realpath &&
+                   (mutt_strcmp(b->realpath, Context->realpath) == 0);
+    if (is_open)
     {
 #ifdef USE_NOTMUCH
       if (b->magic == MUTT_NOTMUCH)
@@ -877,6 +954,18 @@ static void draw_sidebar(int num_rows, int num_cols, int div_width)
       b->msg_flagged = Context->flagged;
     }
 
+    /* Reuse the last text, unless something it shows has changed.
+     * The open mailbox also shows the Context's counts, so always redo it. */
+    if (!is_open && (entry->display_width == w) &&
+        (entry->display_gen == SidebarGeneration) &&
+        (entry->msg_count == b->msg_count) && (entry->msg_unread == b->msg_unread) &&
+        (entry->msg_flagged == b->msg_flagged) && (entry->new == b->new))
+    {
+      printw("%s", entry->display);
+      row++;
+      continue;
+    }
+
     /* compute length of Maildir without trailing separator */
     size_t maildirlen = mutt_strlen(Maildir);
     if (maildirlen && SidebarDelimChars &&
@@ -943,9 +1032,17 @@ static void draw_sidebar(int num_rows, int num_cols, int div_width)
       sidebar_folder_name = b->desc;
     }
 #endif
-    char str[STRING];
-    make_sidebar_entry(str, sizeof(str), w, sidebar_folder_name, entry);
-    printw("%s", str);
+    make_sidebar_entry(entry->display, sizeof(entry->display), w,
+                       sidebar_folder_name, entry);
+    /* the open mailbox's text may show the Context's %d, %t and %L, which
+     * aren't kept in the Buffy; don't let it be reused once it's closed */
+    entry->display_width = is_open ? 0 : w;
+    entry->display_gen = SidebarGeneration;
+    entry->msg_count = b->msg_count;
+    entry->msg_unread = b->msg_unread;
+    entry->msg_flagged = b->msg_flagged;
+    entry->new = b->new;
+    printw("%s", entry->display);
     if (sidebar_folder_depth > 0)
       FREE(&sidebar_folder_name);
     row++;
@@ -1153,6 +1250,7 @@ void mutt_sb_notify_mailbox(struct Buffy *b, int created)
     }
     Entries[EntryCount] = safe_calloc(1, sizeof(struct SbEntry));
     Entries[EntryCount]->buffy = b;
+    EntriesUnsorted = true;
 
     if (TopIndex < 0)
       TopIndex = EntryCount;
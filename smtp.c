@@ -59,6 +59,11 @@
 #define SMTP_PORT 25
 #define SMTPS_PORT 465
 
+/* number of commands sent ahead of their responses (RFC2920) */
+#define SMTP_PIPELINE_DEPTH 32
+/* size of the message chunks sent with BDAT (RFC3030) */
+#define SMTP_CHUNK_SIZE (64 * 1024)
+
 #define SMTP_AUTH_SUCCESS 0
 #define SMTP_AUTH_UNAVAIL 1
 #define SMTP_AUTH_FAIL -1
@@ -70,6 +75,8 @@ enum
   DSN,
   EIGHTBITMIME,
   SMTPUTF8,
+  PIPELINING,
+  CHUNKING,
 
   CAPMAX
 };
@@ -126,6 +133,10 @@ static int smtp_get_resp(struct Connection *conn)
       mutt_bit_set(Capabilities, STARTTLS);
     else if (ascii_strncasecmp("SMTPUTF8", buf + 4, 8) == 0)
       mutt_bit_set(Capabilities, SMTPUTF8);
+    else if (ascii_strncasecmp("PIPELINING", buf + 4, 10) == 0)
+      mutt_bit_set(Capabilities, PIPELINING);
+    else if (ascii_strncasecmp("CHUNKING", buf + 4, 8) == 0)
+      mutt_bit_set(Capabilities, CHUNKING);
 
     if (!valid_smtp_code(buf, n, &n))
       return smtp_err_code;
@@ -139,10 +150,25 @@ static int smtp_get_resp(struct Connection *conn)
   return -1;
 }
 
-static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
+/* Reads responses until no more than max of the *pending commands
+ * sent are waiting for one.  Without PIPELINING, callers pass 0 after
+ * every command. */
+static int smtp_get_resps(struct Connection *conn, int *pending, int max)
+{
+  int r;
+
+  for (; *pending > max; (*pending)--)
+    if ((r = smtp_get_resp(conn)))
+      return r;
+
+  return 0;
+}
+
+static int smtp_rcpt_to(struct Connection *conn, const struct Address *a, int *pending)
 {
   char buf[1024];
   int r;
+  int max = mutt_bit_isset(Capabilities, PIPELINING) ? SMTP_PIPELINE_DEPTH - 1 : 0;
 
   while (a)
   {
@@ -158,7 +184,8 @@ static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
       snprintf(buf, sizeof(buf), "RCPT TO:<%s>\r\n", a->mailbox);
     if (mutt_socket_write(conn, buf) == -1)
       return smtp_err_write;
-    if ((r = smtp_get_resp(conn)))
+    (*pending)++;
+    if ((r = smtp_get_resps(conn, pending, max)))
       return r;
     a = a->next;
   }
@@ -166,6 +193,59 @@ static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
   return 0;
 }
 
+/* Sends the message in BDAT chunks (RFC3030), which need no dot-stuffing.
+ * Lines are only converted to CRLF. */
+static int smtp_bdat(struct Connection *conn, FILE *fp, struct Progress *progress)
+{
+  char cmd[SHORT_STRING];
+  char *chunk = NULL;
+  char *buf = NULL;
+  size_t len, n;
+  char last = '\n';
+  int pending = 0, eof = 0, r = 0;
+  int max = mutt_bit_isset(Capabilities, PIPELINING) ? SMTP_PIPELINE_DEPTH - 1 : 0;
+
+  chunk = safe_malloc(SMTP_CHUNK_SIZE);
+  buf = safe_malloc(2 * SMTP_CHUNK_SIZE + 2);
+
+  while (!eof)
+  {
+    n = fread(chunk, 1, SMTP_CHUNK_SIZE, fp);
+    eof = (n < SMTP_CHUNK_SIZE);
+
+    len = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (chunk[i] == '\n' && (i ? chunk[i - 1] : last) != '\r')
+        buf[len++] = '\r';
+      buf[len++] = chunk[i];
+    }
+    if (n)
+      last = chunk[n - 1];
+    if (eof && last != '\n')
+    {
+      buf[len++] = '\r';
+      buf[len++] = '\n';
+    }
+
+    snprintf(cmd, sizeof(cmd), "BDAT %zu%s\r\n", len, eof ? " LAST" : "");
+    if (mutt_socket_write(conn, cmd) == -1 ||
+        (len && mutt_socket_write_d(conn, buf, len, MUTT_SOCK_LOG_FULL) == -1))
+    {
+      r = smtp_err_write;
+      break;
+    }
+    pending++;
+    if ((r = smtp_get_resps(conn, &pending, eof ? 0 : max)))
+      break;
+    mutt_progress_update(progress, ftell(fp), -1);
+  }
+
+  FREE(&chunk);
+  FREE(&buf);
+  return r;
+}
+
 static int smtp_data(struct Connection *conn, const char *msgfile)
 {
   char buf[1024];
@@ -186,6 +266,13 @@ static int smtp_data(struct Connection *conn, const char *msgfile)
   mutt_progress_init(&progress, _("Sending message..."), MUTT_PROGRESS_SIZE,
                      NetInc, st.st_size);
 
+  if (mutt_bit_isset(Capabilities, CHUNKING))
+  {
+    r = smtp_bdat(conn, fp, &progress);
+    safe_fclose(&fp);
+    return r;
+  }
+
   snprintf(buf, sizeof(buf), "DATA\r\n");
   if (mutt_socket_write(conn, buf) == -1)
   {
@@ -634,6 +721,7 @@ int mutt_smtp_send(const struct Address *from, const struct Address *to,
   const char *envfrom = NULL;
   char buf[1024];
   int ret = -1;
+  int pending = 0;
 
   /* it might be better to synthesize an envelope from from user and host
    * but this condition is most likely arrived at accidentally */
@@ -681,12 +769,17 @@ int mutt_smtp_send(const struct Address *from, const struct Address *to,
       ret = smtp_err_write;
       break;
     }
-    if ((ret = smtp_get_resp(conn)))
+    pending = 1;
+    if (!mutt_bit_isset(Capabilities, PIPELINING) &&
+        (ret = smtp_get_resps(conn, &pending, 0)))
       break;
 
-    /* send the recipient list */
-    if ((ret = smtp_rcpt_to(conn, to)) || (ret = smtp_rcpt_to(conn, cc)) ||
-        (ret = smtp_rcpt_to(conn, bcc)))
+    /* send the recipient list, with PIPELINING the responses to the
+     * envelope are collected once all of it has been sent */
+    if ((ret = smtp_rcpt_to(conn, to, &pending)) ||
+        (ret = smtp_rcpt_to(conn, cc, &pending)) ||
+        (ret = smtp_rcpt_to(conn, bcc, &pending)) ||
+        (ret = smtp_get_resps(conn, &pending, 0)))
       break;
 
     /* send the message data */
@@ -36,6 +36,10 @@
 #include "mx.h"
 #include "nntp.h"
 #endif
+#ifdef USE_IMAP
+#include "mailbox.h"
+#include "imap/imap.h"
+#endif
 
 #define SORTCODE(x) (Sort & SORT_REVERSE) ? -(x) : x
 
@@ -301,6 +305,7 @@ void mutt_sort_headers(struct Context *ctx, int init)
   sort_t *sortfunc = NULL;
 
   unset_option(OPTNEEDRESORT);
+  IndexGeneration++;
 
   if (!ctx)
     return;
@@ -351,6 +356,10 @@ void mutt_sort_headers(struct Context *ctx, int init)
     }
     mutt_sort_threads(ctx, init);
   }
+#ifdef USE_IMAP
+  else if (ctx->magic == MUTT_IMAP && imap_sort_headers(ctx) == 0)
+    ; /* the server did the work */
+#endif
   else if ((sortfunc = mutt_get_sort_func(Sort)) == NULL ||
            (AuxSort = mutt_get_sort_func(SortAux)) == NULL)
   {
@@ -252,6 +252,7 @@ void mutt_draw_tree(struct Context *ctx)
    * From now on we can simply ignore invisible subtrees
    */
   calculate_visibility(ctx, &max_depth);
+  IndexGeneration++;
   pfx = safe_malloc(width * max_depth + 2);
   arrow = safe_malloc(width * max_depth + 2);
   while (tree)
@@ -1136,6 +1137,7 @@ void mutt_set_virtual(struct Context *ctx)
 
   ctx->vcount = 0;
   ctx->vsize = 0;
+  IndexGeneration++;
 
   for (int i = 0; i < ctx->msgcount; i++)
   {